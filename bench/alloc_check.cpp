@@ -0,0 +1,271 @@
+// Allocation regression check for the packet hot path.
+// Counts every operator new (global override) and fails if the steady state allocates:
+//   - SlowPackage serialize/deserialize into reused buffers
+//   - fragmentDataPackagesInto into reused fragments
+//   - the listener -> consumer SpscRing hand-off of packages with a heap payload
+//   - Transaction::send_data end to end (fragmenting, sending, listener, acks), against an
+//     in-process server over loopback, for both UdpClient backends
+// Everything is warmed up first (buffers grow to their final size), then counted.
+// Exits with a non-zero status if any counted phase allocated.
+//
+// usage: ./bin/bench/alloc_check [messages]
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "logger.hpp"
+#include "package_builder.hpp"
+#include "slow_package.hpp"
+#include "spsc_ring.hpp"
+#include "transaction.hpp"
+#include "udp_client.hpp"
+
+#define SERVER_PORT 9871
+#define WARM_UP_MESSAGES 50
+#define SERVER_STTL_MS 60000
+#define RING_SIZE 256 // RECEIVER_RING_SIZE of the Transaction
+
+static std::atomic<bool> counting(false);
+static std::atomic<uint64_t> allocations(0);
+
+void* operator new(size_t size) {
+    if (counting.load(std::memory_order_relaxed)) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == nullptr) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+// counts the allocations made while running body
+template <typename Body>
+static uint64_t count_allocations(Body body) {
+    allocations = 0;
+    counting = true;
+    body();
+    counting = false;
+    return allocations.load();
+}
+
+static bool report(const char* name, uint64_t allocated, uint64_t operations) {
+    std::printf("%-34s %8llu allocations in %llu operations%s\n", name,
+        static_cast<unsigned long long>(allocated), static_cast<unsigned long long>(operations),
+        allocated == 0 ? "" : "  <-- FAIL");
+    return allocated == 0;
+}
+
+static std::string message_of(size_t size) {
+    std::string message(size, 'x');
+    for (size_t i = 0; i < size; i++) {
+        message[i] = static_cast<char>('a' + i % 26);
+    }
+    return message;
+}
+
+static bool check_serialization(uint64_t messages) {
+    SlowPackage package;
+    package.type = SlowPackage::DATA;
+    package.data.assign(reinterpret_cast<const std::byte*>(message_of(1000).data()), 1000);
+
+    std::vector<std::byte> bytes;
+    SlowPackage decoded;
+    auto round_trip = [&] {
+        package.seqnum++;
+        package.serialize(bytes);
+        if (!SlowPackage::deserialize(bytes.data(), bytes.size(), decoded) || decoded.seqnum != package.seqnum) {
+            std::fprintf(stderr, "round trip mismatch\n");
+            std::exit(EXIT_FAILURE);
+        }
+    };
+
+    round_trip();
+    auto allocated = count_allocations([&] {
+        for (uint64_t i = 0; i < messages; i++) {
+            round_trip();
+        }
+    });
+    return report("serialize + deserialize", allocated, messages);
+}
+
+static bool check_fragmentation(uint64_t messages) {
+    std::array<std::byte, 16> sid {};
+    auto large = message_of(4000);
+    auto small = message_of(100);
+    std::vector<SlowPackage> fragments;
+
+    auto fragment = [&](const std::string& message) {
+        fragmentDataPackagesInto(fragments, sid, 1000, 1, 0, 64, 0,
+            reinterpret_cast<const std::byte*>(message.data()), message.size());
+    };
+
+    fragment(large);
+    auto allocated = count_allocations([&] {
+        for (uint64_t i = 0; i < messages; i++) {
+            fragment(i % 2 == 0 ? large : small);
+        }
+    });
+    return report("fragmentDataPackagesInto", allocated, messages);
+}
+
+// same calls as the listener (push_or_drop of the package it keeps) and the consumer (try_pop into its own)
+static bool check_receiver_ring(uint64_t messages) {
+    static SpscRing<SlowPackage, RING_SIZE> ring;
+    SlowPackage listener_package;
+    listener_package.type = SlowPackage::DATA;
+    listener_package.data.assign(reinterpret_cast<const std::byte*>(message_of(100).data()), 100);
+    SlowPackage incoming;
+
+    auto hand_off = [&] {
+        listener_package.seqnum++;
+        ring.push_or_drop(listener_package);
+        if (!ring.try_pop(incoming) || incoming.seqnum != listener_package.seqnum || incoming.data.size() != 100) {
+            std::fprintf(stderr, "ring hand-off mismatch\n");
+            std::exit(EXIT_FAILURE);
+        }
+    };
+
+    // every slot gets its payload buffer once
+    for (size_t i = 0; i < RING_SIZE; i++) {
+        hand_off();
+    }
+    auto allocated = count_allocations([&] {
+        for (uint64_t i = 0; i < messages; i++) {
+            hand_off();
+        }
+    });
+    return report("receiver ring hand-off", allocated, messages);
+}
+
+// minimal SLOW server: accepts every CONNECT, acks every DATA and DISCONNECT.
+// Decodes and encodes into fixed buffers, so it does not allocate either
+static void run_server(int fd, std::atomic<bool>* stop) {
+    std::array<std::byte, 65536> buffer;
+    std::vector<std::byte> out(1500);
+    SlowPackage request;
+    SlowPackage response;
+    response.sid.fill(std::byte{0x42});
+    response.sttl = SERVER_STTL_MS;
+    response.window = 64;
+
+    while (!stop->load()) {
+        sockaddr_in from {};
+        socklen_t len = sizeof(from);
+        ssize_t received = recvfrom(fd, buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr*>(&from), &len);
+        if (received < 0 || !SlowPackage::deserialize(buffer.data(), received, request)) {
+            continue;
+        }
+
+        // deserialize guesses the type from the client side, the flags tell what was sent
+        bool connect = request.flag_connect && !request.flag_revive;
+        bool disconnect = request.flag_connect && request.flag_revive;
+
+        response.seqnum = 100;
+        response.acknum = connect || disconnect ? 0 : request.seqnum;
+        response.flag_accept_reject = true;
+        response.flag_ack = !connect; // SETUP has no ack flag
+
+        response.serialize(out);
+        sendto(fd, out.data(), out.size(), 0, reinterpret_cast<sockaddr*>(&from), len);
+    }
+}
+
+static bool check_transaction(UdpBackend backend, const char* name, uint64_t messages) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SERVER_PORT);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        perror("bind");
+        std::exit(EXIT_FAILURE);
+    }
+    timeval tv {0, 100000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::atomic<bool> stop(false);
+    std::thread server(run_server, fd, &stop);
+
+    bool ok = true;
+    {
+        UdpClient client("127.0.0.1", SERVER_PORT, backend);
+        client.setupConnection();
+        Transaction transaction(&client);
+        if (transaction.connect(deadlineIn(std::chrono::seconds(2))) != OperationStatus::OK) {
+            std::fprintf(stderr, "%s: could not connect to the local server\n", name);
+            std::exit(EXIT_FAILURE);
+        }
+
+        // one fragment and several fragments per message
+        auto small = message_of(1000);
+        auto large = message_of(4000);
+        auto send = [&](uint64_t i) {
+            auto status = transaction.send_data(i % 2 == 0 ? small : large, false, deadlineIn(std::chrono::seconds(2)));
+            if (status != OperationStatus::OK) {
+                std::fprintf(stderr, "%s: send_data failed: %s\n", name, operationStatusToString(status).c_str());
+                std::exit(EXIT_FAILURE);
+            }
+        };
+
+        for (uint64_t i = 0; i < WARM_UP_MESSAGES; i++) {
+            send(i);
+        }
+        auto allocated = count_allocations([&] {
+            for (uint64_t i = 0; i < messages; i++) {
+                send(i);
+            }
+        });
+        ok = report(name, allocated, messages);
+
+        transaction.disconnect(deadlineIn(std::chrono::seconds(2)));
+    }
+
+    stop = true;
+    server.join();
+    close(fd);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    uint64_t messages = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000;
+    setLogLevel(LogLevel::WARNING); // the per packet INFO logs are the only thing left that formats strings
+
+    bool ok = true;
+    ok &= check_serialization(messages * 10);
+    ok &= check_fragmentation(messages * 10);
+    ok &= check_receiver_ring(messages * 10);
+    ok &= check_transaction(UdpBackend::SOCKET, "send_data (socket)", messages);
+    ok &= check_transaction(UdpBackend::IO_URING, "send_data (io_uring)", messages);
+
+    std::printf(ok ? "no allocations in steady state\n" : "steady state allocates\n");
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,262 @@
+// Head-of-line blocking benchmark: latency of small control messages while the same session uploads bulk data.
+// A bulk thread sends large messages back to back, a control thread sends a small message every few
+// milliseconds and measures how long each one takes. Both share one Transaction, three ways:
+//   - one at a time: the callers take turns (a mutex around send_data), so a control message waits
+//     for the bulk message in progress, like with a single message in flight per session
+//   - fair share:    concurrent send_data, same priority and weight, fragments interleaved
+//   - urgent:        concurrent send_data, control messages in the URGENT class, bulk in BULK
+// The local server acks every fragment after a fixed per package delay (a slow link), and reassembles every
+// message by fid and fragment offset, so interleaved messages are checked to arrive whole.
+// Reports control latency (p50/p99/max) and bulk throughput. A control message that waited skips the control
+// messages it made late instead of sending them back to back afterwards (while the bulk thread waits its turn,
+// they would find the link idle). Exits with a non-zero status if a send failed, a message did not reassemble,
+// or the urgent control messages have a higher p50 than one at a time.
+//
+// usage: ./bin/bench/message_priority_bench [seconds per mode] [bulk message size]
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "logger.hpp"
+#include "slow_package.hpp"
+#include "transaction.hpp"
+#include "udp_client.hpp"
+
+#define SERVER_PORT 9873
+#define SERVER_PACKAGE_DELAY_US 40 // time the server takes per package: the link the messages share
+#define SERVER_STTL_MS 60000
+#define CONTROL_SIZE 100
+#define CONTROL_INTERVAL_MS 5
+
+using bench_clock = std::chrono::steady_clock;
+
+enum class Mode {ONE_AT_A_TIME, FAIR_SHARE, URGENT};
+
+// messages reassembled by the server, per fid
+struct ServerState {
+    std::array<std::bitset<256>, 256> fragments; // fragment offsets received of the message in progress
+    std::array<size_t, 256> bytes {};
+    std::array<int, 256> last_fragment {};        // offset of the fragment without the more bit, -1 if not seen yet
+    uint64_t messages = 0;
+    uint64_t message_bytes = 0;
+};
+
+static void complete_if_whole(ServerState* state, uint8_t fid) {
+    int last = state->last_fragment[fid];
+    if (last < 0) {
+        return;
+    }
+    for (int fo = 0; fo <= last; fo++) {
+        if (!state->fragments[fid].test(fo)) {
+            return;
+        }
+    }
+    state->messages++;
+    state->message_bytes += state->bytes[fid];
+    state->fragments[fid].reset();
+    state->bytes[fid] = 0;
+    state->last_fragment[fid] = -1;
+}
+
+// acks every package after SERVER_PACKAGE_DELAY_US and reassembles data by (fid, fo), ignoring copies
+static void run_server(int fd, std::atomic<bool>* stop, ServerState* state) {
+    std::array<std::byte, 65536> buffer;
+    std::vector<std::byte> out;
+    SlowPackage request;
+    SlowPackage response;
+    response.sid.fill(std::byte{0x42});
+    response.sttl = SERVER_STTL_MS;
+    response.window = 64;
+    state->last_fragment.fill(-1);
+
+    while (!stop->load()) {
+        sockaddr_in from {};
+        socklen_t len = sizeof(from);
+        ssize_t received = recvfrom(fd, buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr*>(&from), &len);
+        if (received < 0 || !SlowPackage::deserialize(buffer.data(), received, request)) {
+            continue;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(SERVER_PACKAGE_DELAY_US));
+
+        // deserialize guesses the type from the client side, the flags tell what was sent
+        bool connect = request.flag_connect && !request.flag_revive;
+        bool disconnect = request.flag_connect && request.flag_revive;
+
+        if (!connect && !disconnect && !state->fragments[request.fid].test(request.fo)) {
+            state->fragments[request.fid].set(request.fo);
+            state->bytes[request.fid] += request.data.size();
+            if (!request.flag_mb) {
+                state->last_fragment[request.fid] = request.fo;
+            }
+            complete_if_whole(state, request.fid);
+        }
+
+        response.seqnum = 100;
+        response.acknum = connect || disconnect ? 0 : request.seqnum;
+        response.flag_accept_reject = true;
+        response.flag_ack = !connect; // SETUP has no ack flag
+
+        response.serialize(out);
+        sendto(fd, out.data(), out.size(), 0, reinterpret_cast<sockaddr*>(&from), len);
+    }
+}
+
+struct Result {
+    std::vector<double> control_ms;
+    uint64_t bulk_bytes = 0;
+    uint64_t messages = 0;
+    uint64_t bytes = 0;
+    bool failed = false;
+    double seconds = 0;
+    TransmitStats transmit;
+};
+
+static double percentile(std::vector<double> values, double fraction) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(fraction * values.size()))];
+}
+
+static Result run(Mode mode, double seconds, size_t bulk_size) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SERVER_PORT);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        perror("bind");
+        std::exit(EXIT_FAILURE);
+    }
+    timeval tv {0, 100000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    std::atomic<bool> stop_server(false);
+    auto state = std::make_unique<ServerState>();
+    std::thread server(run_server, fd, &stop_server, state.get());
+
+    Result result;
+    {
+        UdpClient client("127.0.0.1", SERVER_PORT);
+        client.setupConnection();
+        Transaction transaction(&client);
+        if (transaction.connect(deadlineIn(std::chrono::seconds(2))) != OperationStatus::OK) {
+            std::fprintf(stderr, "could not connect to the local server\n");
+            std::exit(EXIT_FAILURE);
+        }
+
+        std::mutex turns; // ONE_AT_A_TIME: a single message in flight
+        std::atomic<bool> stop(false);
+        std::atomic<bool> failed(false);
+        std::string bulk(bulk_size, 'b');
+        std::string control(CONTROL_SIZE, 'c');
+        MessageOptions bulk_options;
+        MessageOptions control_options;
+        if (mode == Mode::URGENT) {
+            bulk_options.priority = MessagePriority::BULK;
+            control_options.priority = MessagePriority::URGENT;
+        }
+
+        auto send = [&](const std::string& message, const MessageOptions& options) {
+            OperationStatus status;
+            if (mode == Mode::ONE_AT_A_TIME) {
+                std::lock_guard<std::mutex> lock(turns);
+                status = transaction.send_data(message, false, deadlineIn(std::chrono::seconds(5)));
+            } else {
+                status = transaction.send_data(message, options, deadlineIn(std::chrono::seconds(5)));
+            }
+            if (status != OperationStatus::OK) {
+                std::fprintf(stderr, "send_data failed: %s\n", operationStatusToString(status).c_str());
+                failed = true;
+            }
+            return status == OperationStatus::OK;
+        };
+
+        // each thread counts its own messages
+        uint64_t bulk_messages = 0;
+        uint64_t control_messages = 0;
+        auto start = bench_clock::now();
+        std::thread bulk_sender([&] {
+            while (!stop) {
+                if (send(bulk, bulk_options)) {
+                    result.bulk_bytes += bulk.size();
+                }
+                bulk_messages++;
+            }
+        });
+
+        auto next = bench_clock::now();
+        while (bench_clock::now() - start < std::chrono::duration<double>(seconds)) {
+            std::this_thread::sleep_until(next);
+            auto sent_at = bench_clock::now();
+            send(control, control_options);
+            auto done = bench_clock::now();
+            result.control_ms.push_back(std::chrono::duration<double, std::milli>(done - sent_at).count());
+            next = std::max(next + std::chrono::milliseconds(CONTROL_INTERVAL_MS), done);
+            control_messages++;
+        }
+        stop = true;
+        bulk_sender.join();
+        result.messages = bulk_messages + control_messages;
+        result.bytes = bulk_messages * bulk.size() + control_messages * control.size();
+        result.seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+        result.failed = failed;
+
+        result.transmit = transaction.transmit_stats();
+        transaction.disconnect(deadlineIn(std::chrono::seconds(2)));
+    }
+
+    stop_server = true;
+    server.join();
+    close(fd);
+
+    if (state->messages != result.messages || state->message_bytes != result.bytes) {
+        std::fprintf(stderr, "server reassembled %llu messages (%llu bytes), %llu (%llu bytes) were sent\n",
+            static_cast<unsigned long long>(state->messages), static_cast<unsigned long long>(state->message_bytes),
+            static_cast<unsigned long long>(result.messages), static_cast<unsigned long long>(result.bytes));
+        result.failed = true;
+    }
+    return result;
+}
+
+static bool print(const char* name, const Result& result) {
+    std::printf("%-14s control p50 %7.2f ms  p99 %7.2f ms  max %7.2f ms   bulk %6.2f MB/s   %llu retransmissions%s\n", name,
+        percentile(result.control_ms, 0.50), percentile(result.control_ms, 0.99), percentile(result.control_ms, 1.0),
+        result.bulk_bytes / result.seconds / 1e6, static_cast<unsigned long long>(result.transmit.retransmissions),
+        result.failed ? "  <-- FAIL" : "");
+    return !result.failed;
+}
+
+int main(int argc, char** argv) {
+    double seconds = argc > 1 ? std::atof(argv[1]) : 3;
+    size_t bulk_size = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 250 * MAX_DATA_SIZE; // fo is 8 bits: 256 fragments at most
+    setLogLevel(LogLevel::ERROR);
+
+    std::printf("bulk messages of %zu bytes, a %d byte control message every %d ms, server takes %d us per package\n",
+        bulk_size, CONTROL_SIZE, CONTROL_INTERVAL_MS, SERVER_PACKAGE_DELAY_US);
+
+    bool ok = true;
+    auto one_at_a_time = run(Mode::ONE_AT_A_TIME, seconds, bulk_size);
+    ok &= print("one at a time", one_at_a_time);
+    ok &= print("fair share", run(Mode::FAIR_SHARE, seconds, bulk_size));
+    auto urgent = run(Mode::URGENT, seconds, bulk_size);
+    ok &= print("urgent", urgent);
+
+    // the window left to the urgent class must keep it at least as fast as taking turns
+    if (percentile(urgent.control_ms, 0.50) > percentile(one_at_a_time.control_ms, 0.50)) {
+        std::fprintf(stderr, "urgent control messages are slower than one at a time\n");
+        ok = false;
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,213 @@
+// Receive path benchmark: a listener thread hands acks over to a consumer collecting the acks of a window
+// of fragments in flight, the way Transaction::send_messages does.
+//   - old design:     the listener appends to a std::vector under a mutex; for each fragment in flight the
+//                     consumer locks it, scans it for the ack and erases the match (check_buffer_for_data
+//                     before the ring, copies of the scanned packages included)
+//   - shipped design: the listener pushes into the SpscRing; once per round the consumer drains it into a
+//                     ReceiveQueue, then takes the ack of each fragment in flight by seqnum
+// The stand-in server acks at most a window ahead of what the consumer collected, in small groups sent in
+// reverse order, and can send some acks twice (acks of retransmitted fragments: nothing asks for the copy,
+// the old buffer keeps it for good, the ReceiveQueue drops it).
+// Reports ns per collected ack and the most packages held by the buffer/queue. Exits with a non-zero status
+// if an ack is missing or does not match its fragment.
+//
+// usage: ./bin/bench/receiver_ring_bench [acks] [window]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "receive_queue.hpp"
+#include "slow_package.hpp"
+#include "spsc_ring.hpp"
+
+#define REORDER_GROUP 4 // acks of each group of fragments arrive last first
+#define RING_SIZE 256   // RECEIVER_RING_SIZE of the Transaction
+
+using bench_clock = std::chrono::steady_clock;
+
+static SlowPackage make_ack(uint32_t acknum) {
+    SlowPackage pkg;
+    pkg.type = SlowPackage::ACK;
+    pkg.flag_ack = true;
+    pkg.flag_accept_reject = true;
+    pkg.acknum = acknum;
+    pkg.window = 64;
+    return pkg;
+}
+
+struct Result {
+    double ns_per_ack = 0;
+    size_t max_depth = 0; // packages held by the buffer/queue at the start of a round, at most
+    bool ok = true;
+};
+
+// acks every fragment below sent (published by the consumer), duplicating one in every duplicate_every
+template <typename Deliver>
+static void run_server(uint32_t acks, const std::atomic<uint32_t>* sent, uint32_t duplicate_every, Deliver deliver) {
+    for (uint32_t group = 0; group < acks; group += REORDER_GROUP) {
+        uint32_t end = std::min(group + REORDER_GROUP, acks);
+        while (sent->load(std::memory_order_acquire) < end) {
+            std::this_thread::yield();
+        }
+        for (uint32_t seqnum = end; seqnum-- > group;) {
+            deliver(make_ack(seqnum));
+            if (duplicate_every > 0 && seqnum % duplicate_every == 0) {
+                deliver(make_ack(seqnum));
+            }
+        }
+    }
+}
+
+// consumer rounds, shared by both designs: looks up the ack of every fragment in flight, then sends (publishes)
+// fragments up to a window past the oldest unacked one. Yields when a round collected nothing
+template <typename StartRound, typename Lookup, typename Depth>
+static void run_consumer(uint32_t acks, uint32_t window, std::atomic<uint32_t>* sent, Result* result,
+        StartRound start_round, Lookup lookup, Depth depth) {
+    std::vector<uint8_t> acked(acks, 0);
+    uint32_t first_unacked = 0;
+    uint32_t in_flight_end = std::min(window, acks);
+    sent->store(in_flight_end, std::memory_order_release);
+
+    SlowPackage ack;
+    while (first_unacked < acks) {
+        start_round();
+        result->max_depth = std::max(result->max_depth, depth());
+        bool collected = false;
+        for (uint32_t seqnum = first_unacked; seqnum < in_flight_end; seqnum++) {
+            if (acked[seqnum] || !lookup(seqnum, &ack)) {
+                continue;
+            }
+            if (ack.acknum != seqnum || ack.type != SlowPackage::ACK) {
+                result->ok = false;
+            }
+            acked[seqnum] = 1;
+            collected = true;
+        }
+
+        while (first_unacked < in_flight_end && acked[first_unacked]) {
+            first_unacked++;
+        }
+        uint32_t end = std::min(first_unacked + window, acks);
+        if (end > in_flight_end) {
+            in_flight_end = end;
+            sent->store(in_flight_end, std::memory_order_release);
+        }
+        if (!collected) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+static Result run_mutex_vector(uint32_t acks, uint32_t window, uint32_t duplicate_every) {
+    std::vector<SlowPackage> buffer;
+    std::mutex buffer_mtx;
+    std::atomic<uint32_t> sent(0);
+    Result result;
+
+    auto start = bench_clock::now();
+    std::thread server([&] {
+        run_server(acks, &sent, duplicate_every, [&](SlowPackage&& pkg) {
+            std::lock_guard<std::mutex> lock(buffer_mtx);
+            buffer.emplace_back(std::move(pkg));
+        });
+    });
+
+    run_consumer(acks, window, &sent, &result,
+        [] {},
+        [&](uint32_t seqnum, SlowPackage* out) {
+            std::lock_guard<std::mutex> lock(buffer_mtx);
+            size_t index = 0;
+            for (auto pack : buffer) {
+                if (pack.acknum == seqnum && pack.type == SlowPackage::ACK) {
+                    *out = pack;
+                    buffer.erase(buffer.begin() + index);
+                    return true;
+                }
+                index++;
+            }
+            return false;
+        },
+        [&] {
+            std::lock_guard<std::mutex> lock(buffer_mtx);
+            return buffer.size();
+        });
+    server.join();
+
+    result.ns_per_ack = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / acks;
+    return result;
+}
+
+static Result run_ring_queue(uint32_t acks, uint32_t window, uint32_t duplicate_every) {
+    static SpscRing<SlowPackage, RING_SIZE> ring;
+    ReceiveQueue queue;
+    std::atomic<uint32_t> sent(0);
+    Result result;
+    SlowPackage incoming;
+
+    auto start = bench_clock::now();
+    // the listener drops on a full ring; here it waits, so both designs move every ack
+    std::thread server([&] {
+        run_server(acks, &sent, duplicate_every, [&](SlowPackage&& pkg) {
+            while (!ring.try_push(std::move(pkg))) {
+                std::this_thread::yield();
+            }
+        });
+    });
+
+    uint32_t awaited = 0;
+    run_consumer(acks, window, &sent, &result,
+        [&] {
+            uint32_t now_sent = sent.load(std::memory_order_relaxed);
+            if (awaited == 0) {
+                queue.expect_acks(0, now_sent);
+            } else if (now_sent > awaited) {
+                queue.expect_more_acks(now_sent - awaited);
+            }
+            awaited = now_sent;
+            while (ring.try_pop(incoming)) {
+                queue.offer(incoming);
+            }
+        },
+        [&](uint32_t seqnum, SlowPackage* out) {
+            return queue.take(SlowPackage::ACK, seqnum, out);
+        },
+        [&] {
+            return queue.pending();
+        });
+    server.join();
+
+    result.ns_per_ack = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count() / acks;
+    return result;
+}
+
+static bool print(const char* name, const Result& result) {
+    std::printf("  %-22s %8.1f ns/ack   up to %6zu packages held%s\n", name, result.ns_per_ack, result.max_depth,
+        result.ok ? "" : "  <-- an ack did not match its fragment");
+    return result.ok;
+}
+
+int main(int argc, char** argv) {
+    uint32_t acks = argc > 1 ? static_cast<uint32_t>(std::atoi(argv[1])) : 200000;
+    uint32_t window = argc > 2 ? static_cast<uint32_t>(std::atoi(argv[2])) : 64;
+
+    std::printf("%u acks, %u fragments in flight, acks of each %d fragments in reverse order\n", acks, window, REORDER_GROUP);
+
+    bool ok = true;
+    for (uint32_t duplicate_every : {0u, 100u}) {
+        if (duplicate_every == 0) {
+            std::printf("no duplicate acks\n");
+        } else {
+            std::printf("1 ack in %u sent twice\n", duplicate_every);
+        }
+        auto old_design = run_mutex_vector(acks, window, duplicate_every);
+        auto shipped = run_ring_queue(acks, window, duplicate_every);
+        ok &= print("mutex + vector scan", old_design);
+        ok &= print("ring + ReceiveQueue", shipped);
+        std::printf("  %-22s %8.2fx\n", "speedup", old_design.ns_per_ack / shipped.ns_per_ack);
+    }
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
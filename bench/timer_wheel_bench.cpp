@@ -0,0 +1,86 @@
+// Timer benchmark: 100k active timers (retransmission / session expiry like delays).
+// Compares the TimerWheel with the per-timer "now >= expiration" scan it replaces.
+//
+// usage: ./bin/bench/timer_wheel_bench [timers]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include "timer_wheel.hpp"
+
+using bench_clock = std::chrono::steady_clock;
+
+static double elapsed_ns(bench_clock::time_point since) {
+    return std::chrono::duration<double, std::nano>(bench_clock::now() - since).count();
+}
+
+int main(int argc, char** argv) {
+    size_t timers = argc > 1 ? static_cast<size_t>(std::atoi(argv[1])) : 100000;
+    const int horizon_ms = 60000; // delays from 1 ms to 1 min
+    const int step_ms = 1;
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> delay_ms(1, horizon_ms);
+    std::vector<int> delays(timers);
+    for (auto& d : delays) {
+        d = delay_ms(rng);
+    }
+
+    // the wheel runs on simulated time, so the benchmark does not depend on sleeping
+    auto start = bench_clock::time_point{};
+    TimerWheel wheel(std::chrono::milliseconds(1), start);
+    std::vector<TimerWheel::TimerId> ids(timers);
+    size_t fired = 0;
+    size_t late = 0;
+    int64_t now_ms = 0;
+
+    auto t0 = bench_clock::now();
+    for (size_t i = 0; i < timers; i++) {
+        int64_t expected = delays[i];
+        ids[i] = wheel.arm(start + std::chrono::milliseconds(delays[i]), [&fired, &late, &now_ms, expected] {
+            fired++;
+            late += now_ms != expected;
+        });
+    }
+    double arm_ns = elapsed_ns(t0) / timers;
+
+    // cancels every other timer (acked fragments)
+    t0 = bench_clock::now();
+    for (size_t i = 0; i < timers; i += 2) {
+        wheel.cancel(ids[i]);
+    }
+    double cancel_ns = elapsed_ns(t0) / ((timers + 1) / 2);
+
+    t0 = bench_clock::now();
+    for (now_ms = step_ms; now_ms <= horizon_ms; now_ms += step_ms) {
+        wheel.advance(start + std::chrono::milliseconds(now_ms));
+    }
+    double wheel_total_ns = elapsed_ns(t0);
+
+    // old approach: every poll compares every pending expiration with now
+    std::vector<int64_t> expirations(delays.begin(), delays.end());
+    std::vector<bool> done(timers, false);
+    for (size_t i = 0; i < timers; i += 2) {
+        done[i] = true;
+    }
+    size_t scan_fired = 0;
+    t0 = bench_clock::now();
+    for (int64_t scan_now = step_ms; scan_now <= horizon_ms; scan_now += step_ms) {
+        for (size_t i = 0; i < timers; i++) {
+            if (!done[i] && scan_now >= expirations[i]) {
+                done[i] = true;
+                scan_fired++;
+            }
+        }
+    }
+    double scan_total_ns = elapsed_ns(t0);
+
+    std::printf("timers:                 %zu (half cancelled), %d ms simulated with %d ms ticks\n", timers, horizon_ms, step_ms);
+    std::printf("arm:                    %8.1f ns/timer\n", arm_ns);
+    std::printf("cancel:                 %8.1f ns/timer\n", cancel_ns);
+    std::printf("wheel advance:          %8.1f ns/tick  (%zu fired, %zu off their tick)\n", wheel_total_ns / horizon_ms, fired, late);
+    std::printf("scan (old):             %8.1f ns/tick  (%zu fired)\n", scan_total_ns / horizon_ms, scan_fired);
+    std::printf("speedup:                %8.2fx\n", scan_total_ns / wheel_total_ns);
+    return (fired == scan_fired && late == 0) ? 0 : 1;
+}
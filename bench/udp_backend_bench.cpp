@@ -0,0 +1,155 @@
+// UdpClient backend benchmark over loopback: sendto/recvfrom (SOCKET) vs io_uring (IO_URING).
+// Send side: datagrams sent one by one (send_bytes) and in batches (send_bytes_batch) to a local sink.
+// Receive side: a local blaster sends datagrams to the client, which polls receive_bytes like the listener does.
+// Reports packets/sec and CPU time per packet of the client thread (user + system, getrusage).
+//
+// usage: ./bin/bench/udp_backend_bench [packets] [datagram size]
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "udp_client.hpp"
+
+#define SINK_PORT 9870
+#define BATCH_SIZE 32
+#define IDLE_TIMEOUT_MS 200 // receive side: gives up when nothing arrives for this long
+
+using bench_clock = std::chrono::steady_clock;
+
+struct Result {
+    uint64_t packets;
+    double seconds;
+    double cpu_seconds;
+};
+
+static double thread_cpu_seconds() {
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static int open_sink() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int size = 8 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SINK_PORT);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        perror("bind");
+        std::exit(EXIT_FAILURE);
+    }
+
+    timeval tv{0, 100000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// drains the sink until stop is set
+static void run_sink(int fd, std::atomic<bool>* stop) {
+    std::vector<char> buffer(65536);
+    while (!stop->load()) {
+        recv(fd, buffer.data(), buffer.size(), 0);
+    }
+}
+
+static Result run_send(UdpBackend backend, bool batched, uint64_t packets, size_t datagram_size) {
+    int sink = open_sink();
+    std::atomic<bool> stop(false);
+    std::thread sink_thread(run_sink, sink, &stop);
+
+    UdpClient client("127.0.0.1", SINK_PORT, backend);
+    client.setupConnection();
+    std::vector<std::vector<std::byte>> datagrams(BATCH_SIZE, std::vector<std::byte>(datagram_size, std::byte{0x5a}));
+
+    double cpu_start = thread_cpu_seconds();
+    auto start = bench_clock::now();
+    uint64_t sent = 0;
+    while (sent < packets) {
+        if (batched) {
+            sent += client.send_bytes_batch(datagrams.data(), std::min<uint64_t>(BATCH_SIZE, packets - sent));
+        } else {
+            sent += client.send_bytes(datagrams[0]) ? 1 : 0;
+        }
+    }
+    double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    double cpu_seconds = thread_cpu_seconds() - cpu_start;
+
+    stop = true;
+    sink_thread.join();
+    close(sink);
+    return Result{sent, seconds, cpu_seconds};
+}
+
+static Result run_receive(UdpBackend backend, uint64_t packets, size_t datagram_size) {
+    int blaster = open_sink();
+
+    UdpClient client("127.0.0.1", SINK_PORT, backend);
+    client.setupConnection();
+    client.send_bytes(std::vector<std::byte>(1)); // lets the blaster learn the client address
+
+    sockaddr_in client_addr{};
+    socklen_t len = sizeof(client_addr);
+    std::vector<char> hello(16);
+    if (recvfrom(blaster, hello.data(), hello.size(), 0, reinterpret_cast<sockaddr*>(&client_addr), &len) < 0) {
+        perror("recvfrom");
+        std::exit(EXIT_FAILURE);
+    }
+
+    std::thread blaster_thread([&] {
+        std::vector<char> datagram(datagram_size, 0x5a);
+        for (uint64_t i = 0; i < packets; i++) {
+            sendto(blaster, datagram.data(), datagram.size(), 0, reinterpret_cast<sockaddr*>(&client_addr), len);
+            if (i % BATCH_SIZE == 0) {
+                std::this_thread::yield(); // lets the client keep up instead of overflowing its socket buffer
+            }
+        }
+    });
+
+    double cpu_start = thread_cpu_seconds();
+    auto start = bench_clock::now();
+    auto last_received = start;
+    uint64_t received = 0;
+    while (received < packets && bench_clock::now() - last_received < std::chrono::milliseconds(IDLE_TIMEOUT_MS)) {
+        if (!client.receive_bytes().empty()) {
+            received++;
+            last_received = bench_clock::now();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    double seconds = std::chrono::duration<double>(last_received - start).count();
+    double cpu_seconds = thread_cpu_seconds() - cpu_start;
+
+    blaster_thread.join();
+    close(blaster);
+    return Result{received, seconds, cpu_seconds};
+}
+
+static void print(const char* name, const Result& result) {
+    std::printf("%-26s %9.0f packets/s %8.2f us cpu/packet (%llu packets)\n", name,
+        result.packets / result.seconds, result.cpu_seconds * 1e6 / result.packets,
+        static_cast<unsigned long long>(result.packets));
+}
+
+int main(int argc, char** argv) {
+    uint64_t packets = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200000;
+    size_t datagram_size = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1200;
+
+    std::printf("packets: %llu, datagram size: %zu\n", static_cast<unsigned long long>(packets), datagram_size);
+    print("send socket (sendto)", run_send(UdpBackend::SOCKET, false, packets, datagram_size));
+    print("send socket (sendmmsg)", run_send(UdpBackend::SOCKET, true, packets, datagram_size));
+    print("send io_uring (single)", run_send(UdpBackend::IO_URING, false, packets, datagram_size));
+    print("send io_uring (batch)", run_send(UdpBackend::IO_URING, true, packets, datagram_size));
+    print("receive socket", run_receive(UdpBackend::SOCKET, packets, datagram_size));
+    print("receive io_uring", run_receive(UdpBackend::IO_URING, packets, datagram_size));
+    return 0;
+}
@@ -0,0 +1,328 @@
+// UDP segmentation offload benchmark over loopback, SOCKET backend with and without GSO/GRO.
+// Messages are fragmented and serialized like Transaction does (max size datagrams, the last one shorter).
+// Send side: each message goes out datagram by datagram (send_bytes, the baseline), or with one
+// send_bytes_batch (sendmmsg of every datagram, or runs of equal sized datagrams handed to the kernel
+// as one UDP_SEGMENT buffer each).
+// Receive side: a local server sends bursts of messages to the client (sendmmsg, or GSO buffers that
+// reach a UDP_GRO socket still coalesced), then the client drains them with receive_bytes and decodes
+// every datagram into a SlowPackage, like the listener does.
+// Reports MB/s, syscalls per MB and CPU time per MB of the client thread (user + system, getrusage).
+// Exits with a non-zero status if a plain batch followed by a GSO batch on the same client loses data.
+//
+// usage: ./bin/bench/udp_offload_bench [MB] [message size]
+#include <arpa/inet.h>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <netinet/udp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "package_builder.hpp"
+#include "slow_package.hpp"
+#include "udp_client.hpp"
+
+#define SINK_PORT 9872
+#define SOCKET_BUFFER_SIZE (8 * 1024 * 1024)
+#define BYTES_PER_QUEUED_DATAGRAM 4096 // kernel memory charged per queued datagram, with room to spare
+#define IDLE_TIMEOUT_MS 200 // receive side: gives up on a burst when nothing arrives for this long
+#define GSO_MAX_SEGMENTS 64
+#define MAX_UDP_PAYLOAD 65507
+
+using bench_clock = std::chrono::steady_clock;
+
+struct Result {
+    uint64_t bytes;
+    uint64_t syscalls;
+    double seconds;
+    double cpu_seconds;
+    uint64_t lost; // datagrams sent but never received (or not decodable)
+};
+
+static double thread_cpu_seconds() {
+    rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+static int open_server_socket() {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int size = SOCKET_BUFFER_SIZE;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    int gro = 1;
+    setsockopt(fd, SOL_UDP, UDP_GRO, &gro, sizeof(gro)); // keeps the sink cheap, it shares the CPU
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SINK_PORT);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        perror("bind");
+        std::exit(EXIT_FAILURE);
+    }
+
+    timeval tv {0, 100000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    return fd;
+}
+
+// one message, fragmented and serialized the way Transaction sends it
+static std::vector<std::vector<std::byte>> serialized_message(size_t size) {
+    std::vector<std::byte> data(size, std::byte {0x5a});
+    std::vector<SlowPackage> fragments;
+    std::array<std::byte, 16> sid {};
+    size_t count = fragmentDataPackagesInto(fragments, sid, 1000, 1, 0, 64, 0, data.data(), data.size());
+
+    std::vector<std::vector<std::byte>> datagrams(count);
+    for (size_t i = 0; i < count; i++) {
+        fragments[i].serialize(datagrams[i]);
+    }
+    return datagrams;
+}
+
+static Result run_send(bool batched, bool offload, uint64_t total_bytes, size_t message_size) {
+    int sink = open_server_socket();
+    std::atomic<bool> stop(false);
+    std::thread sink_thread([&] {
+        std::vector<char> buffer(65536);
+        while (!stop.load()) {
+            recv(sink, buffer.data(), buffer.size(), 0);
+        }
+    });
+
+    UdpClient client("127.0.0.1", SINK_PORT);
+    client.setupConnection();
+    client.setSendBufferSize(SOCKET_BUFFER_SIZE);
+    if (offload && !client.setSendOffload(true)) {
+        std::fprintf(stderr, "UDP_SEGMENT not supported, skipping\n");
+        stop = true;
+        sink_thread.join();
+        close(sink);
+        return Result {};
+    }
+
+    auto datagrams = serialized_message(message_size);
+    uint64_t syscalls_start = client.getSyscallCount();
+    double cpu_start = thread_cpu_seconds();
+    auto start = bench_clock::now();
+    uint64_t sent_bytes = 0;
+    while (sent_bytes < total_bytes) {
+        if (batched) {
+            client.send_bytes_batch(datagrams.data(), datagrams.size());
+        } else {
+            for (const auto& datagram : datagrams) {
+                client.send_bytes(datagram);
+            }
+        }
+        sent_bytes += message_size;
+    }
+    double seconds = std::chrono::duration<double>(bench_clock::now() - start).count();
+    double cpu_seconds = thread_cpu_seconds() - cpu_start;
+    uint64_t syscalls = client.getSyscallCount() - syscalls_start;
+
+    stop = true;
+    sink_thread.join();
+    close(sink);
+    return Result {sent_bytes, syscalls, seconds, cpu_seconds, 0};
+}
+
+// one client sends a plain batch and then, with GSO enabled, a segmented one: the segmented path has to
+// grow its own buffers even though the plain batch already grew the shared ones. Every byte must arrive
+static bool check_plain_then_segmented(size_t message_size) {
+    int sink = open_server_socket();
+    UdpClient client("127.0.0.1", SINK_PORT);
+    client.setupConnection();
+
+    auto datagrams = serialized_message(message_size);
+    uint64_t expected = 0;
+    for (const auto& datagram : datagrams) {
+        expected += datagram.size();
+    }
+
+    size_t sent = client.send_bytes_batch(datagrams.data(), datagrams.size());
+    bool offload = client.setSendOffload(true);
+    if (offload) {
+        sent += client.send_bytes_batch(datagrams.data(), datagrams.size());
+        expected *= 2;
+    }
+
+    // GRO on the sink may hand several datagrams over in one read, so bytes are counted
+    uint64_t received = 0;
+    std::vector<char> buffer(65536);
+    ssize_t bytes;
+    while (received < expected && (bytes = recv(sink, buffer.data(), buffer.size(), 0)) > 0) {
+        received += bytes;
+    }
+    close(sink);
+
+    bool ok = received == expected && sent == datagrams.size() * (offload ? 2 : 1);
+    std::printf("plain batch then GSO batch: %llu of %llu bytes received%s%s\n", static_cast<unsigned long long>(received),
+        static_cast<unsigned long long>(expected), offload ? "" : " (UDP_SEGMENT not supported, plain only)", ok ? "" : "  <-- FAIL");
+    return ok;
+}
+
+// the server side of the receive benchmark: a message per sendmmsg, or per GSO runs
+static void send_message_from_server(int fd, const sockaddr_in& to, const std::vector<std::vector<std::byte>>& datagrams, bool offload) {
+    std::vector<iovec> iovs(datagrams.size());
+    for (size_t i = 0; i < datagrams.size(); i++) {
+        iovs[i].iov_base = const_cast<std::byte*>(datagrams[i].data());
+        iovs[i].iov_len = datagrams[i].size();
+    }
+
+    std::vector<mmsghdr> msgs;
+    alignas(cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] {};
+    if (!offload) {
+        msgs.resize(datagrams.size());
+        for (size_t i = 0; i < datagrams.size(); i++) {
+            msgs[i].msg_hdr.msg_name = const_cast<sockaddr_in*>(&to);
+            msgs[i].msg_hdr.msg_namelen = sizeof(to);
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        sendmmsg(fd, msgs.data(), msgs.size(), 0);
+        return;
+    }
+
+    // every datagram but the last has the full size: GSO buffers of as many datagrams as the kernel takes
+    size_t per_buffer = std::min<size_t>(GSO_MAX_SEGMENTS, MAX_UDP_PAYLOAD / datagrams[0].size());
+    for (size_t first = 0; first < datagrams.size(); first += per_buffer) {
+        msghdr msg {};
+        msg.msg_name = const_cast<sockaddr_in*>(&to);
+        msg.msg_namelen = sizeof(to);
+        msg.msg_iov = &iovs[first];
+        msg.msg_iovlen = std::min(per_buffer, datagrams.size() - first);
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t segment = static_cast<uint16_t>(datagrams[0].size());
+        memcpy(CMSG_DATA(cmsg), &segment, sizeof(segment));
+        if (sendmsg(fd, &msg, 0) < 0) {
+            perror("sendmsg (UDP_SEGMENT)");
+        }
+    }
+}
+
+static Result run_receive(bool offload, uint64_t total_bytes, size_t message_size) {
+    int server = open_server_socket();
+
+    UdpClient client("127.0.0.1", SINK_PORT);
+    client.setupConnection();
+    int receive_buffer = client.setReceiveBufferSize(SOCKET_BUFFER_SIZE);
+    if (offload && !client.setReceiveOffload(true)) {
+        std::fprintf(stderr, "UDP_GRO not supported, skipping\n");
+        close(server);
+        return Result {};
+    }
+    client.send_bytes(std::vector<std::byte>(1)); // lets the server learn the client address
+
+    sockaddr_in client_addr {};
+    socklen_t len = sizeof(client_addr);
+    std::vector<char> hello(16);
+    if (recvfrom(server, hello.data(), hello.size(), 0, reinterpret_cast<sockaddr*>(&client_addr), &len) < 0) {
+        perror("recvfrom");
+        std::exit(EXIT_FAILURE);
+    }
+
+    // bursts that fit in the client socket buffer, so nothing is dropped while the client is not reading
+    auto datagrams = serialized_message(message_size);
+    uint64_t burst_messages = std::max<uint64_t>(1, std::max(receive_buffer, 0) / BYTES_PER_QUEUED_DATAGRAM / datagrams.size());
+    uint64_t messages = (total_bytes + message_size - 1) / message_size;
+
+    std::atomic<uint64_t> queued(0); // messages sent by the server so far
+    std::atomic<uint64_t> drained(0); // messages the client is done with
+    std::thread server_thread([&] {
+        for (uint64_t sent = 0; sent < messages;) {
+            // waits for the client to drain the previous burst
+            while (drained.load() != sent) {
+                std::this_thread::yield();
+            }
+            uint64_t burst = std::min(burst_messages, messages - sent);
+            for (uint64_t i = 0; i < burst; i++) {
+                send_message_from_server(server, client_addr, datagrams, offload);
+            }
+            sent += burst;
+            queued = sent;
+        }
+    });
+
+    std::vector<std::byte> buffer;
+    SlowPackage package;
+    uint64_t received_bytes = 0;
+    uint64_t received_datagrams = 0;
+    uint64_t burst_received = 0;
+    uint64_t syscalls = 0;
+    double cpu_seconds = 0;
+    double seconds = 0;
+    while (drained.load() < messages) {
+        while (queued.load() == drained.load()) {
+            std::this_thread::yield(); // not counted: the server is filling the socket buffer
+        }
+        uint64_t burst = queued.load() - drained.load();
+        uint64_t expected = burst * datagrams.size();
+        burst_received = 0;
+
+        uint64_t syscalls_start = client.getSyscallCount();
+        double cpu_start = thread_cpu_seconds();
+        auto start = bench_clock::now();
+        auto last_received = start;
+        while (burst_received < expected
+                && bench_clock::now() - last_received < std::chrono::milliseconds(IDLE_TIMEOUT_MS)) {
+            ssize_t size = client.receive_bytes(buffer);
+            if (size < 0) {
+                continue;
+            }
+            if (SlowPackage::deserialize(buffer.data(), buffer.size(), package)) {
+                received_bytes += package.data.size();
+                burst_received++;
+            }
+            last_received = bench_clock::now();
+        }
+        seconds += std::chrono::duration<double>(last_received - start).count();
+        cpu_seconds += thread_cpu_seconds() - cpu_start;
+        syscalls += client.getSyscallCount() - syscalls_start;
+
+        received_datagrams += burst_received;
+        drained += burst;
+    }
+
+    server_thread.join();
+    close(server);
+    return Result {received_bytes, syscalls, seconds, cpu_seconds, messages * datagrams.size() - received_datagrams};
+}
+
+static void print(const char* name, const Result& result) {
+    if (result.bytes == 0) {
+        return;
+    }
+    double mb = result.bytes / 1e6;
+    std::printf("%-24s %8.1f MB/s %9.1f syscalls/MB %9.1f us cpu/MB", name,
+        mb / result.seconds, result.syscalls / mb, result.cpu_seconds * 1e6 / mb);
+    if (result.lost > 0) {
+        std::printf(" (%llu datagrams lost)", static_cast<unsigned long long>(result.lost));
+    }
+    std::printf("\n");
+}
+
+int main(int argc, char** argv) {
+    uint64_t total_bytes = (argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 200) * 1000000ULL;
+    size_t message_size = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 60000;
+
+    std::printf("%llu MB in messages of %zu bytes (%zu datagrams each)\n", static_cast<unsigned long long>(total_bytes / 1000000),
+        message_size, serialized_message(message_size).size());
+    print("send sendto", run_send(false, false, total_bytes, message_size));
+    print("send sendmmsg", run_send(true, false, total_bytes, message_size));
+    print("send GSO", run_send(true, true, total_bytes, message_size));
+    print("receive recvfrom", run_receive(false, total_bytes, message_size));
+    print("receive GRO", run_receive(true, total_bytes, message_size));
+    return check_plain_then_segmented(message_size) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Flow and congestion control for a single session.
+// Windows are counted in packages (fragments), the same unit used by the
+// window field of the protocol.
+//
+// - Flow control: never has more packages in flight than the window the
+//   peer advertised in its last SETUP/ACK.
+// - Congestion control: AIMD (slow start up to ssthresh, then +1 package per
+//   round trip; halves on loss, restarts from 1 package on a retransmission timeout).
+// - Retransmission timeout computed from smoothed RTT samples (RFC 6298 style).
+// - Optional pacing: spreads the window over one smoothed RTT instead of bursting it.
+class CongestionControl {
+    public:
+        CongestionControl(uint32_t initial_window = 4, uint32_t max_window = UINT16_MAX);
+
+        // an ack arrived for a package in flight. rtt_sample is only used when
+        // valid_sample is true (it is not for retransmitted packages, Karn's algorithm)
+        void on_ack(std::chrono::microseconds rtt_sample, bool valid_sample);
+
+        // a loss was detected without a timeout (multiplicative decrease)
+        void on_loss();
+
+        // the retransmission timer expired (window restarts from 1, RTO backs off)
+        void on_timeout();
+
+        // window advertised by the peer in its last package
+        void set_peer_window(uint16_t window);
+
+        // how many packages may be in flight right now: min(cwnd, peer window)
+        uint32_t send_window() const;
+
+        std::chrono::microseconds rto() const { return retransmission_timeout; }
+
+        // time to wait between two sends when pacing is enabled, zero otherwise
+        std::chrono::microseconds pacing_interval() const;
+        void set_pacing(bool enabled) { pacing_enabled = enabled; }
+        bool pacing() const { return pacing_enabled; }
+
+        uint32_t congestion_window() const { return static_cast<uint32_t>(cwnd); }
+        uint32_t slow_start_threshold() const { return ssthresh; }
+        uint32_t peer_window() const { return peer_advertised_window; }
+        std::chrono::microseconds smoothed_rtt() const { return srtt; }
+
+    private:
+        double cwnd; // fractional, so congestion avoidance can add 1/cwnd per ack
+        uint32_t ssthresh;
+        uint32_t max_window;
+        uint32_t peer_advertised_window;
+
+        bool has_rtt_sample;
+        std::chrono::microseconds srtt;
+        std::chrono::microseconds rttvar;
+        std::chrono::microseconds retransmission_timeout;
+
+        bool pacing_enabled;
+};
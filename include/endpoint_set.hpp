@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <netinet/in.h>
+
+// a server address
+struct Endpoint {
+    std::string host;
+    int port;
+
+    std::string toString() const { return host + ":" + std::to_string(port); }
+};
+
+// parses "host:port". Returns false if it is not in that format
+bool parseEndpoint(const std::string& text, Endpoint* endpoint);
+
+// Health of a list of equivalent servers, shared by every UdpClient talking to them
+// (e.g. all the sessions of a SessionPool), so what one session learns steers the next ones.
+//
+// For each endpoint it keeps a smoothed RTT (RFC 6298 style) and a smoothed loss rate
+// (fraction of requests that timed out). An endpoint that keeps timing out, or that a
+// client fails over from, is marked down for a while (doubling on every new failure);
+// it gets tried again once that time is over.
+//
+// Thread safe.
+class EndpointSet {
+    public:
+        explicit EndpointSet(const std::vector<Endpoint>& endpoints);
+
+        size_t size() const { return endpoints.size(); }
+        const Endpoint& endpoint(size_t index) const { return endpoints[index].endpoint; }
+        // resolved address. False if the host is not a valid IPv4 address
+        bool address(size_t index, sockaddr_in* address) const;
+
+        // healthy endpoint with the best score (smoothed RTT weighted by loss). Endpoints without
+        // any sample yet come first, so each one gets measured. If every endpoint is down,
+        // the one that comes back first
+        size_t best() const;
+
+        // best endpoint other than the given one, or the same one if it is the only endpoint
+        size_t next_best(size_t excluded) const;
+
+        // a response arrived, rtt after its request
+        void on_response(size_t index, std::chrono::microseconds rtt);
+        // a request got no response in time
+        void on_timeout(size_t index);
+        // marks the endpoint down right away (a client failed over from it)
+        void mark_down(size_t index);
+
+        // how long to wait for a response from the endpoint before retransmitting
+        // or failing over: srtt + 4 * rttvar, or fallback while it has no RTT sample
+        std::chrono::microseconds response_timeout(size_t index, std::chrono::microseconds fallback) const;
+
+        bool healthy(size_t index) const;
+        std::chrono::microseconds smoothed_rtt(size_t index) const;
+        double loss_rate(size_t index) const;
+
+    private:
+        using clock = std::chrono::steady_clock;
+
+        struct EndpointState {
+            Endpoint endpoint;
+            sockaddr_in address;
+            bool valid_address = false;
+
+            bool has_rtt_sample = false;
+            std::chrono::microseconds srtt {0};
+            std::chrono::microseconds rttvar {0};
+            double loss = 0;
+            int consecutive_timeouts = 0;
+            int failures = 0; // times it was marked down in a row, sets how long it stays down
+            clock::time_point down_until;
+        };
+
+        mutable std::mutex mtx;
+        std::vector<EndpointState> endpoints;
+
+        size_t best_locked(size_t excluded) const;
+        double score(const EndpointState& state) const;
+        void mark_down_locked(EndpointState& state);
+};
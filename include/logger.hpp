@@ -1,6 +1,14 @@
 #pragma once
 #include <iostream>
+#include <string_view>
 
 enum class LogLevel {INFO, WARNING, ERROR};
 
-void Log(LogLevel level, const std::string& msg) ;
\ No newline at end of file
+// messages below the level are discarded (INFO by default)
+void setLogLevel(LogLevel level);
+
+// true if a message of this level would be printed. Hot paths check it before
+// building a message, so a quiet logger costs no string allocation
+bool LogEnabled(LogLevel level);
+
+void Log(LogLevel level, std::string_view msg) ;
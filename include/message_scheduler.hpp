@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// priority class of a message. Fragments of a higher class always go first
+enum class MessagePriority : uint8_t {BULK, NORMAL, URGENT};
+
+// Picks which of the messages in flight of a session sends the next fragment.
+//
+// Strict priority between classes: a message only sends while no message of a higher class has
+// fragments waiting. Within a class, weighted round robin at fragment granularity (deficit round robin
+// with a quantum of weight fragments): two transfers with weights 3 and 1 share the window 3:1, and a
+// new message starts sending on the next turn instead of waiting for the others to finish.
+//
+// Priority alone only reorders what is waiting: a bulk transfer could still fill the whole window, and an
+// urgent fragment would queue at the peer behind it. So while a higher class is in use (it has a message,
+// or sent a fragment in the last CLASS_HOLD_MS, as more of it may come), a class may only have
+// 1/LOWER_CLASS_WINDOW_SHARE of the window in flight. The rest is left to the higher classes.
+//
+// Not thread safe: owned by the thread driving the sends.
+class MessageScheduler {
+    public:
+        // a message with fragments to send. weight is its share among messages of the same class (at least 1)
+        void add(uint32_t id, MessagePriority priority, uint32_t weight, size_t fragments);
+        // the message is over (acked, failed or given up on). Its fragments in flight no longer count
+        void remove(uint32_t id);
+
+        // a held message keeps its place but sends nothing until released
+        // (e.g. the rest of a revive message, until the server accepts the revive)
+        void hold(uint32_t id, bool held);
+
+        // the message the next fragment comes from (the fragment is taken, and counts as in flight until acked).
+        // False if nothing can be sent, or the class it would come from has its share of window in flight
+        bool next(uint32_t* id, uint32_t window, std::chrono::steady_clock::time_point now);
+        // puts back a fragment taken by next that could not be sent
+        void give_back(uint32_t id);
+        // a fragment of the message in flight was acked
+        void acked(uint32_t id);
+
+        size_t size() const { return entries.size(); }
+
+    private:
+        struct Entry {
+            uint32_t id;
+            MessagePriority priority;
+            uint32_t weight;
+            size_t remaining; // fragments not taken yet
+            uint32_t credit;  // fragments it may still take this round
+            bool held;
+            size_t in_flight; // taken and not acked yet
+        };
+
+        static constexpr size_t CLASSES = 3;
+
+        std::vector<Entry> entries; // in arrival order. Only grows, so the steady state does not allocate
+        size_t cursor = 0; // where the round robin goes on from
+        std::array<size_t, CLASSES> class_in_flight {};
+        std::array<std::chrono::steady_clock::time_point, CLASSES> class_last_sent {};
+
+        // most fragments of the class that may be in flight
+        uint32_t class_limit(MessagePriority priority, uint32_t window, std::chrono::steady_clock::time_point now) const;
+
+        static bool can_send(const Entry& entry) { return entry.remaining > 0 && !entry.held; }
+        Entry* find(uint32_t id);
+};
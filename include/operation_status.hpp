@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Result of a Transaction operation
+enum class OperationStatus {
+    OK,
+    TIMEOUT,        // deadline reached or retransmission budget exhausted without a response
+    REJECTED,       // the server answered, but refused the connect/revive
+    EXPIRED,        // the session time to live (sttl) is over
+    CANCELLED,      // the caller cancelled the operation through its CancellationToken
+    NOT_CONNECTED,  // the operation needs a connected session
+    SEND_FAILED,    // the socket refused to send
+    TOO_LARGE       // the message needs more fragments than a fid can number (MAX_FRAGMENTS)
+};
+
+std::string operationStatusToString(OperationStatus status);
+
+// absolute point in time an operation must finish by
+using Deadline = std::chrono::steady_clock::time_point;
+
+// no deadline: the operation is only bounded by its retransmission budget
+inline constexpr Deadline NO_DEADLINE = Deadline::max();
+
+// deadline timeout from now
+inline Deadline deadlineIn(std::chrono::milliseconds timeout) {
+    return std::chrono::steady_clock::now() + timeout;
+}
+
+// Cancellation flag shared between the caller and a running operation.
+// The caller keeps the token alive and may cancel it from any thread;
+// operations check it while waiting and return OperationStatus::CANCELLED
+class CancellationToken {
+    public:
+        void cancel() { cancelled.store(true, std::memory_order_release); }
+        void reset() { cancelled.store(false, std::memory_order_release); }
+        bool is_cancelled() const { return cancelled.load(std::memory_order_acquire); }
+
+    private:
+        std::atomic<bool> cancelled {false};
+};
@@ -7,6 +7,16 @@
 #include"slow_package.hpp"
 #include <vector>
 
+// size of the package header, in bytes
+#define HEADER_SIZE 32
+
+// default max data bytes carried by a single package (1472 bytes of UDP payload - 32 bytes of header).
+// Sessions can use a different size, see Transaction::set_max_payload
+#define MAX_DATA_SIZE 1440
+
+// fragments a message can have: fo (fragment offset) is 8 bits
+#define MAX_FRAGMENTS 256
+
 SlowPackage connectPackage(uint16_t window);
 
 // Return a disconnect package, requires session data
@@ -17,13 +27,20 @@ SlowPackage disconnectPackage(std::array<std::byte, 16> sid, uint32_t sttl, uint
 // implements their logic bases on asssumptions
 //
 // Given some data, returns a vector of SlowPackages
-// fragmented by the max size
+// fragmented by the max size (max_data_size bytes of data per package)
 std::vector<SlowPackage> fragmentedDataPackages(std::array<std::byte, 16> sid, uint32_t sttl, uint32_t seqnum, 
-    uint32_t acknum, uint16_t window, uint8_t fid, std::vector<std::byte> data);
+    uint32_t acknum, uint16_t window, uint8_t fid, std::vector<std::byte> data, uint32_t max_data_size = MAX_DATA_SIZE);
+
+// Same as fragmentedDataPackages, but fills packages in place (the caller keeps size within MAX_FRAGMENTS packages): the vector only grows, so once it
+// is big enough (and its payloads too) no memory is allocated. Returns how many packages were
+// written (the first ones of the vector, the rest are stale)
+size_t fragmentDataPackagesInto(std::vector<SlowPackage>& packages, const std::array<std::byte, 16>& sid, uint32_t sttl,
+    uint32_t seqnum, uint32_t acknum, uint16_t window, uint8_t fid, const std::byte* data, size_t size,
+    uint32_t max_data_size = MAX_DATA_SIZE);
 
 // Same as data packages, but the first packag
 std::vector<SlowPackage> fragmentedRevivePackages(std::array<std::byte, 16> sid, uint32_t sttl, uint32_t seqnum, 
-    uint32_t acknum, uint16_t window, uint8_t fid, std::vector<std::byte> data);
+    uint32_t acknum, uint16_t window, uint8_t fid, std::vector<std::byte> data, uint32_t max_data_size = MAX_DATA_SIZE);
 
 // clasifies a response package based on flags
 SlowPackage::PackageType classifyResponsePackage(const SlowPackage& pkg) ;
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+// Byte container for the package data field.
+// Small payloads (up to INLINE_CAPACITY bytes) live inside the object itself,
+// so header-only packages (ACK, SETUP, CONNECT, DISCONNECT) never touch the heap.
+// Bigger payloads fall back to a heap buffer. The interface mimics the subset
+// of std::vector<std::byte> the rest of the code uses.
+class PackagePayload {
+    public:
+        static constexpr uint32_t INLINE_CAPACITY = 16;
+
+        using value_type = std::byte;
+        using iterator = std::byte*;
+        using const_iterator = const std::byte*;
+
+        PackagePayload();
+        PackagePayload(const std::vector<std::byte>& bytes);
+        PackagePayload(const PackagePayload& other);
+        PackagePayload(PackagePayload&& other) noexcept;
+        ~PackagePayload();
+
+        PackagePayload& operator=(const PackagePayload& other);
+        PackagePayload& operator=(PackagePayload&& other) noexcept;
+
+        std::byte* data() { return is_inline() ? inline_bytes : heap_bytes; }
+        const std::byte* data() const { return is_inline() ? inline_bytes : heap_bytes; }
+
+        iterator begin() { return data(); }
+        iterator end() { return data() + length; }
+        const_iterator begin() const { return data(); }
+        const_iterator end() const { return data() + length; }
+
+        size_t size() const { return length; }
+        size_t capacity() const { return allocated; }
+        bool empty() const { return length == 0; }
+
+        std::byte& operator[](size_t i) { return data()[i]; }
+        const std::byte& operator[](size_t i) const { return data()[i]; }
+
+        void clear() { length = 0; }
+        void reserve(size_t new_capacity);
+        void resize(size_t new_size);
+        void push_back(std::byte b);
+
+        // inserts the range [first, last) before pos (pos must belong to this payload)
+        template <typename InputIt>
+        iterator insert(const_iterator pos, InputIt first, InputIt last) {
+            size_t offset = pos - begin();
+            size_t count = std::distance(first, last);
+            reserve(length + count);
+
+            std::byte* base = data();
+            std::memmove(base + offset + count, base + offset, length - offset);
+            std::byte* out = base + offset;
+            for (; first != last; ++first) {
+                *out++ = static_cast<std::byte>(*first);
+            }
+            length += count;
+            return base + offset;
+        }
+
+        void assign(const std::byte* bytes, size_t count);
+
+        std::vector<std::byte> to_vector() const { return std::vector<std::byte>(begin(), end()); }
+
+    private:
+        uint32_t length;
+        uint32_t allocated; // == INLINE_CAPACITY while the inline storage is in use
+        union {
+            std::byte inline_bytes[INLINE_CAPACITY];
+            std::byte* heap_bytes;
+        };
+
+        bool is_inline() const { return allocated <= INLINE_CAPACITY; }
+        void release();
+};
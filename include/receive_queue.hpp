@@ -0,0 +1,91 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "slow_package.hpp"
+
+// a is after b in sequence number order (RFC 1982 style, so it keeps working across the wrap around)
+inline bool seqnum_after(uint32_t a, uint32_t b) {
+    return static_cast<int32_t>(a - b) > 0;
+}
+
+// what the receive side of a session did with the packages the listener decoded
+struct ReceiveStats {
+    uint64_t accepted = 0;   // packages an operation was waiting for
+    uint64_t duplicates = 0; // copies of a package already received (e.g. acks of a retransmitted fragment)
+    uint64_t stale = 0;      // packages nothing waits for anymore: other session, outside the ack window, late responses
+    uint64_t coalesced = 0;  // newest acks replaced by a newer one before their window was read
+    uint64_t overflow = 0;   // dropped by the listener because the receiver ring was full
+};
+
+// Consumer side of the receive path: keeps only the packages an operation of the session is waiting for.
+//
+// The Transaction says what it waits for: the acks of the fragments in flight (expect_acks) and/or the
+// response of an exchange (expect_response). Anything else is dropped and counted, so duplicates,
+// retransmitted SETUPs and acks of operations that already gave up cannot pile up.
+//
+// Each awaited ack is kept in the slot of its fragment, so take returns the ack that matched (its accept
+// flag, seqnum and window). The newest ack (highest acknum) is also kept aside for the window and seqnum
+// updates: take_latest_ack hands it over once, and the ones it replaced unread are counted as coalesced.
+// Memory is one state byte and one header-only package per fragment in flight plus two packages,
+// whatever the server sends.
+//
+// Not thread safe: owned by the consumer thread, like the rest of the Transaction state.
+class ReceiveQueue {
+    public:
+        // once the session is known, packages of any other session are stale
+        void set_session(const std::array<std::byte, 16>& sid);
+        void clear_session();
+
+        // acks for seqnums [first, first + count) are awaited, one per fragment
+        void expect_acks(uint32_t first, size_t count);
+        // count more acks are awaited, for the seqnums right after the last awaited one
+        // (fragments of several messages being sent one window at a time)
+        void expect_more_acks(size_t count);
+        // the ack of this seqnum is not awaited anymore (its message was given up on)
+        void forget_ack(uint32_t seqnum);
+        void clear_acks();
+
+        // one response of this type and acknum is awaited
+        void expect_response(SlowPackage::PackageType type, uint32_t acknum);
+        void clear_response();
+
+        // filters a package handed over by the listener. Returns false if it was dropped
+        bool offer(const SlowPackage& package);
+
+        // takes the awaited package with this type and acknum if it arrived
+        bool take(SlowPackage::PackageType type, uint32_t acknum, SlowPackage* package);
+
+        // the newest fragment ack, if one arrived since the last call (for window and seqnum updates)
+        bool take_latest_ack(SlowPackage* package);
+
+        // packages held right now (counted in the advertised receive window)
+        size_t pending() const;
+
+        const ReceiveStats& stats() const { return counters; }
+
+    private:
+        enum AckState : uint8_t {AWAITED, ARRIVED, TAKEN};
+
+        bool has_session = false;
+        std::array<std::byte, 16> session {};
+
+        uint32_t ack_first = 0;
+        std::vector<uint8_t> ack_states; // AckState of each fragment in flight, reused between messages.
+                                         // Fragments taken at the front are dropped as the window moves on
+        std::vector<SlowPackage> ack_packages; // ack of each ARRIVED fragment, same index as ack_states (may be longer)
+        size_t pending_acks = 0; // arrived but not taken yet
+        bool has_latest_ack = false;
+        bool latest_ack_unread = false;
+        SlowPackage latest_ack;
+
+        bool response_expected = false;
+        SlowPackage::PackageType response_type = SlowPackage::RAW;
+        uint32_t response_acknum = 0;
+        bool has_response = false;
+        SlowPackage response;
+
+        ReceiveStats counters;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "operation_status.hpp"
+#include "transaction.hpp"
+#include "udp_client.hpp"
+#include "endpoint_set.hpp"
+
+// counters of a SessionPool since it was created
+struct SessionPoolStats {
+    uint64_t hits = 0;     // leases served right away by a ready idle session
+    uint64_t misses = 0;   // leases that had to connect a session first
+    uint64_t revived = 0;  // idle sessions revived in the background (disconnected, sttl not over yet)
+    uint64_t replaced = 0; // idle sessions replaced in the background by a new connection (sttl over)
+    uint64_t failures = 0; // connects and revives that failed
+    size_t idle = 0;       // sessions waiting to be leased
+    size_t leased = 0;     // sessions currently leased
+};
+
+// Pool of connected sessions to one server, so a unit of work does not pay for connect + disconnect.
+//
+// Each session is a Transaction with its own UdpClient (its own socket and listener thread).
+// warm_up connects all of them concurrently: every CONNECT is sent first, then the SETUPs are
+// collected, so the pool is ready after about one RTT whatever its size.
+//
+// lease/release are thread safe; a leased Transaction belongs to the caller until it is released.
+// A background thread looks after the idle sessions: a session disconnected by its last caller is
+// revived while its sttl lasts, an expired one is replaced by a new connection.
+class SessionPool {
+    public:
+        SessionPool(const std::string& host, int port, size_t size, UdpBackend backend = UdpBackend::SOCKET,
+            std::chrono::milliseconds maintenance_interval = std::chrono::milliseconds(100));
+        // sessions spread over several servers: every session shares the endpoint health,
+        // so new and replaced sessions go to the fastest healthy endpoint
+        SessionPool(std::shared_ptr<EndpointSet> endpoints, size_t size, UdpBackend backend = UdpBackend::SOCKET,
+            std::chrono::milliseconds maintenance_interval = std::chrono::milliseconds(100));
+        // stops the maintenance thread and disconnects the idle sessions.
+        // Every leased session must be released before
+        ~SessionPool();
+
+        // creates and connects the sessions (pipelined), then starts the maintenance thread.
+        // Returns how many sessions are ready
+        size_t warm_up(Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
+
+        // returns a connected session, connecting one if no idle session is ready (a miss).
+        // Returns nullptr if that connect fails
+        Transaction* lease(Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
+
+        // gives a leased session back. It can be left connected or disconnected
+        void release(Transaction* transaction);
+
+        // disconnects the idle sessions (all sharing the same deadline)
+        void close(Deadline deadline = NO_DEADLINE);
+
+        SessionPoolStats stats() const;
+
+    private:
+        struct Session {
+            std::unique_ptr<UdpClient> client;
+            std::unique_ptr<Transaction> transaction;
+        };
+
+        std::shared_ptr<EndpointSet> endpoints;
+        size_t size;
+        UdpBackend backend;
+        std::chrono::milliseconds maintenance_interval;
+
+        mutable std::mutex mtx;
+        std::vector<std::unique_ptr<Session>> sessions; // every session, idle or leased
+        std::vector<Session*> idle;
+        SessionPoolStats counters;
+
+        std::thread maintenance_thread;
+        std::condition_variable maintenance_cv;
+        bool stopping = false;
+
+        Session* create_session();
+        // ready to be leased as is: connected and within its sttl. Called without mtx (it may log)
+        static bool ready(Session* session);
+        // removes the session from the idle ones, false if it is not there (leased or under repair). mtx held
+        bool take_idle(Session* session);
+
+        // connects every session given with their CONNECTs in flight at the same time.
+        // Returns how many were accepted, the others are left disconnected
+        size_t connect_all(const std::vector<Session*>& pending, Deadline deadline, const CancellationToken* token);
+
+        void maintain();
+        void maintenance_loop();
+};
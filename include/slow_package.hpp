@@ -5,45 +5,71 @@
 #include <cstddef>
 #include <array>
 #include <vector>
+#include <type_traits>
+#include "package_payload.hpp"
 
 
 
-class SlowPackage {
+// Fixed-size part of a package (everything but the data field).
+// Flags and the package type are packed in a single byte and the whole
+// struct is trivially copyable, so it can be memcpy'd around and stored in
+// tightly packed buffers/retransmit queues.
+struct SlowPackageHeader {
+    // enum for package types, defined in spcification
+    enum PackageType : uint8_t {
+        CONNECT,
+        SETUP,
+        DATA,
+        ACK,
+        RAW ,// no data, default
+        DISCONNECT
+    };
+    // Data fields, check project specification for more information
+    std::array<std::byte, 16> sid {};
+    uint32_t sttl = 0;
+    uint32_t seqnum = 0;
+    uint32_t acknum = 0;
+    uint16_t window = 0;
+    uint8_t fid = 0;
+    uint8_t fo = 0;
+    // Package flags (one bit each)
+    bool flag_connect : 1 = false;
+    bool flag_revive : 1 = false;
+    bool flag_ack : 1 = false;
+    bool flag_accept_reject : 1 = false;
+    bool flag_mb : 1 = false;
+    PackageType type : 3 = RAW;
+};
+
+static_assert(std::is_trivially_copyable_v<SlowPackageHeader>, "SlowPackageHeader must be trivially copyable");
+static_assert(sizeof(SlowPackageHeader) <= 36, "SlowPackageHeader should stay compact");
+
+class SlowPackage : public SlowPackageHeader {
     public:
-      // enum for package types, defined in spcification
-      enum PackageType {
-          CONNECT,
-          SETUP,
-          DATA,
-          ACK,
-          RAW ,// no data, default
-          DISCONNECT
-        };
-      // Data fields, check project specification for more information
-      std::array<std::byte, 16> sid;
-      uint32_t sttl;
-      // Package flags
-      bool flag_connect;
-      bool flag_revive;
-      bool flag_ack;
-      bool flag_accept_reject;
-      bool flag_mb;
-      uint32_t seqnum;
-      uint32_t acknum;
-      uint16_t window;
-      uint8_t fid;
-      uint8_t fo;
-      std::vector<std::byte> data;
-      PackageType type;
+      PackagePayload data;
       // Public methods
       SlowPackage(); //Constructor
+      SlowPackage(const SlowPackage& other) = default;
+      SlowPackage(SlowPackage&& other) noexcept = default;
+      SlowPackage& operator=(const SlowPackage& other) = default;
+      SlowPackage& operator=(SlowPackage&& other) noexcept = default;
       ~SlowPackage(); //Destructor
-      std::vector<std::byte> serialize(); // Serializer
+      std::vector<std::byte> serialize() const; // Serializer
+      // serializes into out, reusing its capacity (no allocation once out is big enough)
+      void serialize(std::vector<std::byte>& out) const;
       static SlowPackage* deserialize(std::vector<std::byte> data); // static deserializer
+      // deserializes size bytes into out, reusing its payload buffer. False if too short to be a package
+      static bool deserialize(const std::byte* bytes, size_t size, SlowPackage& out);
       std::string toString(); // For debugging purposes
+
+      SlowPackageHeader& header() { return *this; }
+      const SlowPackageHeader& header() const { return *this; }
     private:
         PackageType findPackageType();
 };
 
+// header-only packages fit in a single cache line
+static_assert(sizeof(SlowPackage) <= 64, "SlowPackage should fit in a cache line");
+
 
 #endif // SLOW_PACKAGE_H
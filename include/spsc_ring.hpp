@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// cache line size used to pad the indices (avoids false sharing between
+// the producer and the consumer cores)
+inline constexpr size_t SPSC_CACHE_LINE = 64;
+
+// Bounded lock-free single-producer/single-consumer ring.
+// Exactly one thread may push (the listener thread) and exactly one thread may pop
+// (the Transaction consumer). When the ring is full, try_push fails and the producer
+// decides what to do (see push_or_drop, which counts the dropped items).
+template <typename T, size_t Capacity>
+class SpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "SpscRing capacity must be a power of two");
+
+    public:
+        SpscRing() = default;
+        SpscRing(const SpscRing&) = delete;
+        SpscRing& operator=(const SpscRing&) = delete;
+
+        // producer side. Returns false (and leaves item untouched) if the ring is full
+        template <typename U>
+        bool try_push(U&& item) {
+            const size_t t = tail.load(std::memory_order_relaxed);
+            if (t - cached_head >= Capacity) {
+                // refreshes the consumer position only when the ring looks full
+                cached_head = head.load(std::memory_order_acquire);
+                if (t - cached_head >= Capacity) {
+                    return false;
+                }
+            }
+
+            slots[t & (Capacity - 1)] = std::forward<U>(item);
+            tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // producer side. Same as try_push, but counts the item as dropped when full
+        template <typename U>
+        bool push_or_drop(U&& item) {
+            if (try_push(std::forward<U>(item))) {
+                return true;
+            }
+            drops.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+
+        // consumer side. Returns false if the ring is empty.
+        // Copy-assigns into out, so the slot and out both keep the buffers they own (a move would hand
+        // the slot's buffer over, and the next push into that slot would allocate a new one)
+        bool try_pop(T& out) {
+            const size_t h = head.load(std::memory_order_relaxed);
+            if (h == cached_tail) {
+                cached_tail = tail.load(std::memory_order_acquire);
+                if (h == cached_tail) {
+                    return false;
+                }
+            }
+
+            out = std::as_const(slots[h & (Capacity - 1)]);
+            head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        // approximate number of queued items (exact when called from a quiescent state)
+        size_t size() const {
+            return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+        }
+
+        bool empty() const { return size() == 0; }
+
+        static constexpr size_t capacity() { return Capacity; }
+
+        // number of items rejected by push_or_drop since construction
+        uint64_t dropped() const { return drops.load(std::memory_order_relaxed); }
+
+    private:
+        // consumer owned
+        alignas(SPSC_CACHE_LINE) std::atomic<size_t> head {0};
+        size_t cached_tail = 0;
+
+        // producer owned
+        alignas(SPSC_CACHE_LINE) std::atomic<size_t> tail {0};
+        size_t cached_head = 0;
+
+        alignas(SPSC_CACHE_LINE) std::atomic<uint64_t> drops {0};
+
+        alignas(SPSC_CACHE_LINE) std::array<T, Capacity> slots {};
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "timer_wheel.hpp"
+
+// A TimerWheel shared by every session of the process, advanced by its own driver thread.
+// Sessions arm and cancel timers from any thread. The driver sleeps until the earliest timer may fire
+// (indefinitely while none is armed), so idle sessions cost no wakeups.
+//
+// Callbacks run on the driver thread with the service locked: they post the expiry to their owner
+// (set a flag, queue a key, notify it) and must not arm or cancel timers themselves. Once cancel()
+// returns, the callback of that timer is either over or will never run.
+class TimerService {
+    public:
+        using clock = TimerWheel::clock;
+        using Callback = TimerWheel::Callback;
+        using TimerId = TimerWheel::TimerId;
+
+        // the process wide service, started on first use. Never destroyed, so sessions
+        // torn down during static destruction can still cancel their timers
+        static TimerService& shared();
+
+        TimerService();
+        ~TimerService();
+
+        TimerId arm_after(std::chrono::microseconds delay, Callback callback);
+
+        // false if the timer already fired or was cancelled
+        bool cancel(TimerId id);
+
+        // true while the timer has neither fired nor been cancelled
+        bool armed(TimerId id);
+
+    private:
+        std::mutex mtx;
+        std::condition_variable cv; // an earlier timer was armed, or the service is stopping
+        TimerWheel wheel;
+        clock::time_point wake_at = clock::time_point::max(); // when the driver wakes up next
+        bool stopping = false;
+        std::thread driver;
+
+        void run();
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Hierarchical timer wheel (5 levels of 64 slots, 1 ms ticks by default).
+// Arm, cancel and expire are O(1) per timer: a timer lives in one slot list and is
+// moved down one level at a time (cascading) as its expiry gets closer. With 1 ms
+// ticks it covers 64^5 ms (~12 days), enough for any 27 bits sttl; later timers are
+// parked in the last level and re-inserted until they are in range.
+//
+// Not thread safe: arm/cancel/advance must be called by the thread that owns the wheel,
+// and callbacks run on that thread, inside advance().
+class TimerWheel {
+    public:
+        using clock = std::chrono::steady_clock;
+        using Callback = std::function<void()>;
+
+        // handle to an armed timer. A default constructed id refers to no timer
+        struct TimerId {
+            uint32_t index = 0;
+            uint32_t generation = 0; // 0: invalid
+        };
+
+        TimerWheel(std::chrono::milliseconds tick = std::chrono::milliseconds(1), clock::time_point start = clock::now());
+
+        // arms a timer that fires on the first advance() at or after expiry
+        TimerId arm(clock::time_point expiry, Callback callback);
+        TimerId arm_after(std::chrono::microseconds delay, Callback callback);
+
+        // cancels a timer. Returns false if it already fired or was cancelled
+        bool cancel(TimerId id);
+
+        // moves the wheel up to now, running the callbacks of every expired timer.
+        // Returns how many timers fired
+        size_t advance(clock::time_point now);
+
+        // true while the timer has neither fired nor been cancelled
+        bool armed(TimerId id) const;
+
+        // earliest time a timer may fire (exact for timers due within 64 ticks, a lower bound for later ones,
+        // which cascade first). time_point::max() when no timer is armed
+        clock::time_point next_expiry() const;
+
+        // number of armed timers
+        size_t active() const { return active_timers; }
+
+    private:
+        static constexpr int LEVELS = 5;
+        static constexpr int SLOT_BITS = 6;
+        static constexpr uint32_t SLOTS = 1u << SLOT_BITS;
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        struct TimerNode {
+            uint64_t expiry_tick = 0;
+            Callback callback;
+            uint32_t prev = NONE;
+            uint32_t next = NONE;
+            uint32_t generation = 1;
+            uint16_t level = 0;
+            uint16_t slot = 0;
+            bool armed = false;
+        };
+
+        std::chrono::microseconds tick_duration;
+        clock::time_point start_time;
+        uint64_t current_tick;
+        size_t active_timers;
+
+        std::vector<TimerNode> nodes; // timer pool, reused through free_nodes
+        std::vector<uint32_t> free_nodes;
+        uint32_t heads[LEVELS][SLOTS];
+        size_t level_counts[LEVELS]; // timers linked in each level, lets advance skip empty stretches
+
+        uint64_t tick_of(clock::time_point time) const;
+
+        // links the node in the slot matching its expiry
+        void link(uint32_t index);
+        void unlink(uint32_t index);
+
+        // moves every timer of a higher level slot to the lower levels
+        void cascade(int level, uint32_t slot);
+};
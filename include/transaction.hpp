@@ -4,33 +4,130 @@
 #include <chrono>
 #include <iostream>
 #include <mutex>
+#include <atomic>
+#include <bitset>
+#include <condition_variable>
+#include <memory>
 #include<vector>
 #include<thread>
 #include "udp_client.hpp"
 #include "slow_package.hpp"
+#include "spsc_ring.hpp"
+#include "congestion_control.hpp"
+#include "package_builder.hpp"
+#include "operation_status.hpp"
+#include "timer_service.hpp"
+#include "receive_queue.hpp"
+#include "message_scheduler.hpp"
+
+// number of decoded packages the listener thread can hand over before it starts dropping
+#define RECEIVER_RING_SIZE 256
 
 
 enum class ConnectionStatus {OFFLINE, CONNECTED, EXPIRED, CONNECTING};
+
+// how a message shares the session with the other messages in flight (see MessageScheduler)
+struct MessageOptions {
+    MessagePriority priority = MessagePriority::NORMAL;
+    uint32_t weight = 1; // share of the window among messages in flight of the same priority
+};
+
+// packages sent by a Transaction since it was created
+struct TransmitStats {
+    uint64_t packages_sent = 0;   // every package, retransmissions included
+    uint64_t retransmissions = 0; // fragments and connect/disconnect packages sent again after a loss or timeout
+};
+
 class Transaction {
     public:
         Transaction(UdpClient* client);
         ~Transaction();
 
         // transaction functions
+        //
+        // Every operation takes an absolute deadline and an optional cancellation token.
+        // Retransmissions happen inside that budget; without a deadline the operation
+        // gives up once its retransmission budget is exhausted (OperationStatus::TIMEOUT)
         
-        // sends a connect and awaits a setup. Returns true if accepted, false if rejected
-        bool connect();
+        // sends a connect and awaits a setup. OK if accepted, REJECTED if refused by the server
+        OperationStatus connect(Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
+
+        // connect in two steps, so many sessions can have their CONNECT in flight at once (see SessionPool):
+        // begin_connect sends the CONNECT right away, finish_connect waits for the SETUP (retransmitting the CONNECT)
+        OperationStatus begin_connect();
+        OperationStatus finish_connect(Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
         
-        // sends data flow (to be implemented)
-        bool send_data(std::string data, bool revive = false, int attempts_left = 5);
+        // sends data, fragmented by the session max payload. With revive, the session is revived first
+        OperationStatus send_data(const std::string& data, bool revive = false, Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
+
+        // sends data as one of several messages in flight on the session: each message gets its own fid,
+        // and their fragments share the window by priority and weight, so a small urgent message does not
+        // wait behind a bulk transfer. Can be called from several threads at once (one caller sends the
+        // fragments of every message, the others wait for theirs). Connect, disconnect, revive and stream
+        // mode still run on one thread and not while these sends are in progress
+        OperationStatus send_data(const std::string& data, const MessageOptions& options, Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
         
-        // sends a disconnect to the server
-        bool disconnect();
+        // max data bytes per package for this session (MAX_DATA_SIZE by default).
+        // Also grows the client receive buffer if needed
+        void set_max_payload(size_t bytes);
+        size_t max_payload() const;
+
+        // largest message send_data takes (MAX_FRAGMENTS packages), larger ones return TOO_LARGE.
+        // Stream mode splits what it sends into messages of at most this size
+        size_t max_message_size() const;
+
+        // runs path MTU discovery towards the server and uses the result as the max payload.
+        // Returns false (keeping the current size) if the discovery fails
+        bool discover_max_payload();
+
+        // stream mode: writes are buffered and sent as full DATA packages once flush_threshold bytes
+        // are pending or the oldest pending byte is older than flush_deadline. Nothing runs the deadline in
+        // the background: it is only checked on write and flush_if_due, so a producer that goes quiet must
+        // call flush_if_due (by stream_flush_due_at) or flush itself.
+        // flush_threshold = 0 means one full package (max_payload bytes)
+        void enable_stream_mode(size_t flush_threshold = 0, std::chrono::milliseconds flush_deadline = std::chrono::milliseconds(5));
+
+        // flushes whatever is pending and goes back to one send_data per write
+        OperationStatus disable_stream_mode(Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
+
+        // sends data right away, or buffers it when stream mode is enabled
+        OperationStatus write(const std::string& data, Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
+
+        // sends every pending stream byte now
+        OperationStatus flush(Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
+
+        // flushes only if the flush deadline of the pending bytes has passed.
+        // Call it from idle loops so a quiet producer does not keep data corked
+        OperationStatus flush_if_due(Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
+
+        // when the pending stream bytes are due, NO_DEADLINE if none are pending
+        Deadline stream_flush_due_at() const;
+
+        // sends a disconnect to the server. Pending stream bytes are flushed first: if that fails,
+        // returns the flush status without disconnecting (the bytes stay buffered)
+        OperationStatus disconnect(Deadline deadline = NO_DEADLINE, const CancellationToken* token = nullptr);
+
+        // verifies if the connection is still valid (according to the expiration time).
+        // Only reads the expiration flag set by the timer thread, so any thread can call it
+        bool connection_still_alive() const;
+
+        // number of packages the listener had to drop because the receiver ring was full
+        uint64_t dropped_packages() const;
+
+        // what the receive side kept and dropped (duplicates, stale packages, coalesced acks, ring overflow).
+        // Call it from the thread that runs the operations
+        ReceiveStats receive_stats() const;
+
+        // packages sent and retransmitted. Call it from the thread that runs the operations
+        TransmitStats transmit_stats() const;
+
+        // spreads each window of fragments over one RTT instead of sending it as a burst
+        void enable_pacing(bool enabled);
 
-        // verifies if the connection is still valid (according to the expiration time)
-        bool connection_still_alive();
+        // flow and congestion control state of this session
+        const CongestionControl& congestion_control() const;
 
-        ConnectionStatus connection_status;
+        std::atomic<ConnectionStatus> connection_status; // read by the listener thread
 
     private:
         UdpClient *client;
@@ -39,20 +136,167 @@ class Transaction {
         int session_port;
 
         // session data
-        std::chrono::time_point<std::chrono::steady_clock> session_expiration;
+        TimerWheel::TimerId session_expiration; // fires when the sttl is over
+        std::atomic<bool> session_expired {true}; // set by the timer thread
 
         uint32_t current_seqnum; // package number
         uint32_t current_sttl;
-        uint32_t last_acknum; // last ack received from server
+        uint32_t last_acknum = 0; // newest acknum received from server (sequence number order)
 
-        std::vector<SlowPackage> receiver_buffer; // keeps everything received from the server
-        std::mutex buffer_mtx;
+        // listener thread -> consumer hand-off (lock free, single producer / single consumer)
+        SpscRing<SlowPackage, RECEIVER_RING_SIZE> receiver_ring;
+        // packages already taken out of the ring that an operation waits for. Only touched by the consumer
+        ReceiveQueue receive_queue;
+        SlowPackage incoming_package; // popped from the ring, reused
+        TransmitStats transmit_counters;
         std::mutex connection_status_mtx;
 
-        // checks the buffer (thread safe) for a specific acknum and type package;
+        CongestionControl cc;
+
+        // retransmission and sttl timers, on the wheel shared by every session (driven by its own thread).
+        // Their callbacks only post the expiry here: a flag, or a key in posted_expiries
+        TimerService& timers = TimerService::shared();
+
+        // wakes the thread running an operation: the listener published a package, a timer expired
+        // or another caller submitted a message
+        std::mutex wake_mtx;
+        std::condition_variable wake_cv;
+        uint64_t wakeups = 0;      // guarded by wake_mtx
+        uint64_t wakeups_seen = 0; // by the waiting thread, guarded by wake_mtx
+        std::vector<uint64_t> posted_expiries; // guarded by wake_mtx, keys like expired_fragments
+        void wake_consumer();
+        // posts a fragment retransmission timeout (slot << 32 | fragment), from the timer thread
+        void post_expiry(uint64_t key);
+        // blocks until a wakeup newer than the previous wait, until, or CANCEL_CHECK_MS at most
+        // (a cancelled token does not wake anyone up)
+        void wait_for_events(std::chrono::steady_clock::time_point until);
+
+        // (re)arms the session expiration timer for sttl milliseconds from now
+        void arm_session_expiration(uint32_t sttl);
+
+        size_t session_max_payload = MAX_DATA_SIZE;
+
+        // CONNECT sent by begin_connect, retransmitted by finish_connect
+        SlowPackage connect_request;
+        std::chrono::steady_clock::time_point connect_sent_at;
+        bool connect_pending = false;
+
+        // stream mode (corking)
+        bool stream_mode = false;
+        size_t stream_flush_threshold = 0; // 0: one full package
+        std::chrono::milliseconds stream_flush_deadline {5};
+        std::string stream_buffer;
+        std::chrono::time_point<std::chrono::steady_clock> stream_buffered_since; // time of the oldest pending byte
+
+        // sends the first count bytes of the stream buffer as one message
+        OperationStatus send_stream_bytes(size_t count, Deadline deadline, const CancellationToken* token);
+
+        // send_data on raw bytes
+        OperationStatus send_message(const std::byte* data, size_t size, const MessageOptions& options, bool revive,
+            Deadline deadline, const CancellationToken* token);
+
+        // per fragment state of a message in flight
+        struct FragmentState {
+            bool acked = false;
+            bool retransmitted = false;
+            int later_acks = 0; // fragments sent after this one that were already acked
+            std::chrono::steady_clock::time_point sent_at;
+            TimerWheel::TimerId rto_timer;
+        };
+
+        // a message being sent. Kept in a slot reused by later messages (the buffers only grow),
+        // so a steady stream of messages does not allocate
+        struct OutgoingMessage {
+            uint32_t slot = 0; // index in message_slots, also its id in the scheduler
+            uint8_t fid = 0;
+            MessageOptions options;
+            bool revive = false; // the first fragment revives the session, the rest waits for the accept
+            bool revive_accepted = false;
+            Deadline deadline = NO_DEADLINE;
+            const CancellationToken* token = nullptr;
+
+            std::vector<SlowPackage> fragments; // seqnum, acknum and window are set when first sent
+            std::vector<std::vector<std::byte>> serialized; // serialized once, retransmissions resend the same bytes
+            std::vector<FragmentState> states;
+            size_t count = 0;         // fragments of this message (the vectors may hold more, from earlier ones)
+            size_t sent = 0;          // the first sent fragments went out at least once
+            size_t acked = 0;
+            size_t first_unacked = 0;
+            SlowPackage last_ack;
+
+            bool scheduled = false; // in active_messages. Only touched by the sending thread
+            bool done = false;      // guarded by send_mtx
+            OperationStatus status = OperationStatus::OK;
+        };
+
+        // messages handed over by callers, guarded by send_mtx
+        std::mutex send_mtx;
+        std::condition_variable send_cv; // a message finished, a fid was freed or the sending thread left
+        bool sending = false; // a caller is sending for every message in flight
+        // capacity reserved up front (one slot per fid), so adding a slot never moves the ones the
+        // sending thread reads without the lock
+        std::vector<std::unique_ptr<OutgoingMessage>> message_slots;
+        std::vector<OutgoingMessage*> free_messages;
+        std::vector<OutgoingMessage*> submitted_messages; // not picked up by the sending thread yet
+        std::bitset<256> fids_in_use; // a fid is only reused once its message is over
+        uint8_t next_fid = 0;
+
+        // state of the messages in flight, owned by the thread sending them
+        std::vector<OutgoingMessage*> active_messages;
+        MessageScheduler scheduler;
+        uint32_t fragments_in_flight = 0;
+        uint32_t recovery_seqnum = 0; // losses before this seqnum belong to a loss event already reacted to
+        int consecutive_timeouts = 0;
+        std::chrono::steady_clock::time_point last_timeout_at; // fragments sent before it already timed out with it
+        std::chrono::steady_clock::time_point next_send_at;
+        std::vector<std::vector<std::byte>> batch_bytes; // the batch being sent, swapped in from the messages
+        std::vector<std::pair<OutgoingMessage*, size_t>> batch_fragments; // message and fragment of each one
+        std::vector<uint64_t> expired_fragments; // slot << 32 | fragment, whose retransmission timer fired
+        std::vector<uint32_t> acked_seqnums; // acked in the current round, for loss detection
+        uint32_t latest_ack_seqnum = 0; // seqnum of the newest fragment ack, becomes current_seqnum once every message is over
+        std::vector<std::byte> exchange_bytes;
+
+        // receive capacity we advertise to the server (free slots for incoming packages)
+        uint16_t receive_window() const;
+
+        // sends the fragments of every message in flight respecting the congestion and peer windows, picking
+        // them with the scheduler and retransmitting on loss or timeout, until own is over (acked or failed)
+        void send_messages(OutgoingMessage* own);
+        // moves the messages handed over by callers into active_messages
+        void adopt_submitted_messages();
+        // the message is over: stops its timers, forgets its acks and hands status to its caller
+        void finish_message(OutgoingMessage* message, OperationStatus status);
+        // unacked fragments sent before seqnum are lost once REORDER_THRESHOLD later ones are acked
+        void detect_losses(uint32_t acked_seqnum);
+        // the newest fragment ack sets the peer window and the seqnum to go on from
+        void apply_latest_ack();
+        void retransmit_fragment(OutgoingMessage* message, size_t fragment);
+        void arm_fragment_timer(OutgoingMessage* message, size_t fragment);
+
+        // sends a single package and waits for the response of the given type and acknum,
+        // retransmitting it (with exponential backoff) until the deadline or the retry budget is over.
+        // A CONNECT that gets no response fails over to the next endpoint of the client, if there is one.
+        // With already_sent_at, the first transmission is skipped (the request went out at that time)
+        OperationStatus exchange(SlowPackage& request, SlowPackage::PackageType response_type, uint32_t acknum,
+            SlowPackage* response, Deadline deadline, const CancellationToken* token,
+            std::chrono::steady_clock::time_point already_sent_at = {});
+
+        // spawns the listener thread (joining a previous, already finished, one)
+        void start_listener();
+        // sets the status to OFFLINE and waits for the listener thread to finish
+        void stop_listener();
+
+        // drains the ring into the receiver buffer and checks it for a specific acknum and type package;
         // if it finds, returns true, removes the package from the buffer and sets package to the found value
         bool check_buffer_for_data(SlowPackage::PackageType type, uint32_t acknum, SlowPackage* package);
+        // moves everything the listener published so far into the receive queue
+        void drain_receiver_ring();
 
         std::thread listener_thread;
+        // reused by the listener thread for every datagram
+        std::vector<std::byte> listener_bytes;
+        SlowPackage listener_package;
+        std::atomic<bool> listener_running {false};
+        int listener_wake_fd = -1; // eventfd written by stop_listener, so the listener does not wait out its poll
         void listen_to_incoming_data();
 };
\ No newline at end of file
@@ -1,14 +1,36 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <memory>
 #include <string>
 #include <vector>
 #include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "endpoint_set.hpp"
 
 
+class IoUringBackend;
+
+// I/O backend of a UdpClient, chosen at construction
+enum class UdpBackend {
+    SOCKET,   // sendto/sendmmsg and recvfrom (default, works everywhere)
+    IO_URING  // io_uring: multishot receives into a registered buffer pool, batched sends.
+              // Falls back to SOCKET when the kernel does not support it
+};
+
 class UdpClient {
 public:
     
-    UdpClient(const std::string& host, int port);
+    UdpClient(const std::string& host, int port, UdpBackend backend = UdpBackend::SOCKET);
+
+    // several equivalent servers: each connect goes to the best endpoint (see EndpointSet)
+    // and a client can fail over to the next one
+    UdpClient(const std::vector<Endpoint>& endpoints, UdpBackend backend = UdpBackend::SOCKET);
+
+    // endpoints shared with other clients, so their health is learned by all of them
+    UdpClient(std::shared_ptr<EndpointSet> endpoints, UdpBackend backend = UdpBackend::SOCKET);
 
     ~UdpClient();
 
@@ -18,18 +40,106 @@ public:
 
     bool send_bytes(const std::vector<std::byte>& data);
 
-    std::vector<char> receive_chars(int buffer_size = 1472);
+    // sends count datagrams with a single syscall (sendmmsg or one io_uring submission).
+    // Returns how many were sent: the first ones, the rest can be sent again. With io_uring a datagram
+    // that failed may come before others that went out, it is then counted as sent (and lost)
+    size_t send_bytes_batch(const std::vector<std::byte>* datagrams, size_t count);
+
+    // buffer_size <= 0 uses the max datagram size
+    std::vector<char> receive_chars(int buffer_size = 0);
+
+    std::vector<std::byte> receive_bytes(int buffer_size = 0);
 
-    std::vector<std::byte> receive_bytes(int buffer_size = 1472);
+    // receives into out (resized to the datagram, its capacity is kept), so a buffer reused
+    // between calls does not allocate. Returns the datagram size, -1 if nothing was received
+    ssize_t receive_bytes(std::vector<std::byte>& out, int buffer_size = 0);
+
+    // blocks until a datagram may be waiting for receive_bytes (true), the timeout passes or wake_fd
+    // (e.g. an eventfd, -1 for none) becomes readable (false). Does not read wake_fd
+    bool waitForData(std::chrono::milliseconds timeout, int wake_fd = -1);
 
     bool setReceiveTimeout(long seconds, long microseconds);
 
+    // UDP generic segmentation offload (UDP_SEGMENT, SOCKET backend only). send_bytes_batch hands the
+    // kernel each run of equal sized datagrams as one buffer, cut back into datagrams by the kernel
+    // (or the NIC), so a large fragmented message costs a few trips down the stack instead of one per fragment.
+    // Returns false if the kernel or the backend does not support it
+    bool setSendOffload(bool enabled);
+
+    // UDP generic receive offload (UDP_GRO, SOCKET backend only). The kernel may deliver back-to-back
+    // datagrams of the server in one coalesced buffer; receive_bytes splits it again, one datagram per call.
+    // Set it before the listener starts. Returns false if the kernel or the backend does not support it
+    bool setReceiveOffload(bool enabled);
+
+    // SO_SNDBUF / SO_RCVBUF (SO_*BUFFORCE first, which ignores net.core.wmem_max/rmem_max when the
+    // process has CAP_NET_ADMIN). Returns the size the kernel actually uses (about twice the request,
+    // it counts its bookkeeping too), -1 on failure
+    int setSendBufferSize(int bytes);
+    int setReceiveBufferSize(int bytes);
+
+    // send/receive syscalls made so far (sendto, sendmmsg, recvfrom, recvmsg, poll, io_uring_enter)
+    uint64_t getSyscallCount() const;
+
+    // largest UDP payload sent/received by this client (1472 by default)
+    void setMaxDatagramSize(size_t size);
+    size_t getMaxDatagramSize() const;
+
+    // path MTU discovery towards the server (IP_MTU_DISCOVER with IP_PMTUDISC_PROBE + probe packets).
+    // Returns the largest UDP payload that reaches the server without IP fragmentation, 0 on failure.
+    // Does not change the max datagram size by itself. The probes start with probe_header and are padded
+    // with zeros: give it a package the server drops, so the probes are not taken for data
+    size_t discoverMaxDatagramSize(const std::vector<std::byte>& probe_header = {});
+
+    // backend actually in use (IO_URING may have fallen back to SOCKET)
+    UdpBackend getBackend() const;
+
+    // points the client to the best endpoint right now (called before starting a new session)
+    void selectEndpoint();
+
+    // marks the current endpoint down and moves to the next best one.
+    // Returns false if there is no other endpoint to go to
+    bool failover();
+
+    // feed the health of the current endpoint
+    void reportResponse(std::chrono::microseconds rtt);
+    void reportTimeout();
+
+    // how long to wait for a response from the current endpoint (fallback while it has no RTT sample)
+    std::chrono::microseconds responseTimeout(std::chrono::microseconds fallback) const;
+
+    const Endpoint& currentEndpoint() const;
+    std::shared_ptr<EndpointSet> getEndpoints() const;
+
 private:
-    std::string host;
-    int port;
+    std::shared_ptr<EndpointSet> endpoints;
+    std::atomic<size_t> current_endpoint; // also read by the receiving thread
     int sockfd;
     struct sockaddr_in listening_address;
-    struct sockaddr_in servaddr;
-    struct sockaddr_in clientaddr;
+    struct sockaddr_in servaddr; // address of the current endpoint
+    struct sockaddr_in clientaddr; // source of the last received datagram
     bool is_connected;
+    std::atomic<size_t> max_datagram_size; // also read by the receiving thread, set while it runs
+    UdpBackend backend;
+    IoUringBackend* uring; // only with the IO_URING backend
+    std::vector<struct mmsghdr> send_msgs; // reused by send_bytes_batch
+    std::vector<struct iovec> send_iovs;
+    std::vector<std::byte> receive_buffer; // reused by every receive call
+    std::atomic<uint64_t> io_syscalls; // socket backend syscalls (sends and receives come from different threads)
+
+    // segmentation offload state
+    bool send_offload;
+    bool receive_offload;
+    std::vector<size_t> send_runs; // datagrams in each message of the last offloaded batch
+    std::vector<char> send_controls; // one UDP_SEGMENT control message per message
+    std::vector<std::byte> coalesced_buffer; // last buffer received with GRO
+    size_t coalesced_length;
+    size_t coalesced_offset; // next datagram to hand out
+    size_t coalesced_segment; // size of each datagram in it (the last one may be shorter)
+
+    size_t sendSegmented(const std::vector<std::byte>* datagrams, size_t count);
+    ssize_t receiveCoalesced(std::vector<std::byte>& out);
+    int setBufferSize(int force_option, int option, int bytes);
+
+    // datagrams from anything but the current endpoint (e.g. late replies from the one we failed over from) are dropped
+    bool fromCurrentEndpoint(const sockaddr_in& from) const;
 };
\ No newline at end of file
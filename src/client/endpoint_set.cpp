@@ -0,0 +1,170 @@
+#include "endpoint_set.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#define TIMEOUTS_BEFORE_DOWN 3 // timeouts in a row before an endpoint is marked down
+#define INITIAL_DOWN_TIME_MS 1000
+#define MAX_DOWN_TIME_MS 30000
+#define MIN_RESPONSE_TIMEOUT_MS 50
+#define LOSS_WEIGHT 4 // a 25% loss rate doubles the score of an endpoint
+
+bool parseEndpoint(const std::string& text, Endpoint* endpoint) {
+    auto colon = text.rfind(':');
+    if (colon == std::string::npos || colon == 0 || colon + 1 == text.size()) {
+        return false;
+    }
+
+    char* end = nullptr;
+    long port = std::strtol(text.c_str() + colon + 1, &end, 10);
+    if (*end != '\0' || port <= 0 || port > 65535) {
+        return false;
+    }
+
+    endpoint->host = text.substr(0, colon);
+    endpoint->port = static_cast<int>(port);
+    return true;
+}
+
+EndpointSet::EndpointSet(const std::vector<Endpoint>& endpoints) {
+    for (const auto& endpoint : endpoints) {
+        EndpointState state;
+        state.endpoint = endpoint;
+        memset(&state.address, 0, sizeof(state.address));
+        state.address.sin_family = AF_INET;
+        state.address.sin_port = htons(endpoint.port);
+        state.valid_address = inet_pton(AF_INET, endpoint.host.c_str(), &state.address.sin_addr) > 0;
+        this->endpoints.push_back(state);
+    }
+}
+
+bool EndpointSet::address(size_t index, sockaddr_in* address) const {
+    if (index >= this->endpoints.size() || !this->endpoints[index].valid_address) {
+        return false;
+    }
+    *address = this->endpoints[index].address;
+    return true;
+}
+
+double EndpointSet::score(const EndpointState& state) const {
+    if (!state.has_rtt_sample) {
+        // never measured: tried first, unless it only ever timed out
+        return state.loss > 0 ? std::numeric_limits<double>::max() / 2 : 0;
+    }
+    return state.srtt.count() * (1 + LOSS_WEIGHT * state.loss);
+}
+
+size_t EndpointSet::best_locked(size_t excluded) const {
+    auto now = clock::now();
+    size_t best = excluded;
+    double best_score = std::numeric_limits<double>::max();
+    size_t soonest = excluded;
+    auto soonest_up = clock::time_point::max();
+
+    for (size_t i = 0; i < this->endpoints.size(); i++) {
+        const auto& state = this->endpoints[i];
+        if (i == excluded || !state.valid_address) {
+            continue;
+        }
+
+        if (state.down_until <= now) {
+            if (score(state) < best_score) {
+                best_score = score(state);
+                best = i;
+            }
+        } else if (state.down_until < soonest_up) {
+            soonest_up = state.down_until;
+            soonest = i;
+        }
+    }
+
+    if (best != excluded) {
+        return best;
+    }
+    return soonest;
+}
+
+size_t EndpointSet::best() const {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    size_t best = this->best_locked(this->endpoints.size());
+    return best < this->endpoints.size() ? best : 0;
+}
+
+size_t EndpointSet::next_best(size_t excluded) const {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    return this->best_locked(excluded);
+}
+
+void EndpointSet::on_response(size_t index, std::chrono::microseconds rtt) {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    auto& state = this->endpoints[index];
+
+    if (!state.has_rtt_sample) {
+        state.srtt = rtt;
+        state.rttvar = rtt / 2;
+        state.has_rtt_sample = true;
+    } else {
+        auto delta = state.srtt > rtt ? state.srtt - rtt : rtt - state.srtt;
+        state.rttvar = (state.rttvar * 3 + delta) / 4;
+        state.srtt = (state.srtt * 7 + rtt) / 8;
+    }
+
+    state.loss = state.loss * 7 / 8;
+    state.consecutive_timeouts = 0;
+    state.failures = 0;
+    state.down_until = clock::time_point();
+}
+
+void EndpointSet::on_timeout(size_t index) {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    auto& state = this->endpoints[index];
+
+    state.loss = state.loss * 7 / 8 + 1.0 / 8;
+    if (++state.consecutive_timeouts >= TIMEOUTS_BEFORE_DOWN) {
+        this->mark_down_locked(state);
+    }
+}
+
+void EndpointSet::mark_down(size_t index) {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    this->mark_down_locked(this->endpoints[index]);
+}
+
+void EndpointSet::mark_down_locked(EndpointState& state) {
+    auto down_time = std::chrono::milliseconds(std::min<long long>(
+        static_cast<long long>(INITIAL_DOWN_TIME_MS) << std::min(state.failures, 16), MAX_DOWN_TIME_MS));
+    state.down_until = clock::now() + down_time;
+    state.failures++;
+    state.consecutive_timeouts = 0;
+
+    Log(LogLevel::WARNING, "[endpoints] " + state.endpoint.toString() + " marked down for " + std::to_string(down_time.count()) + " ms");
+}
+
+std::chrono::microseconds EndpointSet::response_timeout(size_t index, std::chrono::microseconds fallback) const {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    const auto& state = this->endpoints[index];
+    if (!state.has_rtt_sample) {
+        return fallback;
+    }
+    auto timeout = std::max<std::chrono::microseconds>(state.srtt + state.rttvar * 4, std::chrono::milliseconds(MIN_RESPONSE_TIMEOUT_MS));
+    return std::min(timeout, fallback);
+}
+
+bool EndpointSet::healthy(size_t index) const {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    return this->endpoints[index].down_until <= clock::now();
+}
+
+std::chrono::microseconds EndpointSet::smoothed_rtt(size_t index) const {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    return this->endpoints[index].srtt;
+}
+
+double EndpointSet::loss_rate(size_t index) const {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    return this->endpoints[index].loss;
+}
@@ -0,0 +1,392 @@
+#include "io_uring_backend.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <thread>
+#include <unistd.h>
+
+#define RECV_RING_ENTRIES 8
+#define SEND_RING_ENTRIES 64 // max datagrams per io_uring_enter
+#define RECV_BUFFER_COUNT 64 // datagrams the kernel can hold before the listener picks them up (power of 2)
+#define RECV_CQ_ENTRIES 128 // every filled buffer holds a completion until it is read, so room for all of them
+#define RECV_BUFFER_GROUP 0
+#define RECV_USER_DATA 1
+#define CANCEL_USER_DATA SEND_RING_ENTRIES // above every send index of the send ring
+#define RING_RETRY_MS 1 // wait before asking a failing ring for completions again
+
+IoUringBackend::IoUringBackend(int sockfd) : sockfd(sockfd) {
+}
+
+IoUringBackend* IoUringBackend::create(int sockfd, size_t buffer_size) {
+    auto backend = new IoUringBackend(sockfd);
+
+    if (!setup_ring(backend->send_ring, SEND_RING_ENTRIES) || !backend->setup_receive(buffer_size)) {
+        delete backend;
+        return nullptr;
+    }
+
+    backend->send_msgs.resize(SEND_RING_ENTRIES);
+    backend->send_iovs.resize(SEND_RING_ENTRIES);
+    backend->send_results.resize(SEND_RING_ENTRIES);
+    return backend;
+}
+
+IoUringBackend::~IoUringBackend() {
+    destroy_receive();
+    destroy_ring(send_ring);
+}
+
+bool IoUringBackend::setup_ring(Ring& ring, unsigned entries, unsigned cq_entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    if (cq_entries > 0) {
+        // completions that do not fit the queue are only flushed by io_uring_enter, which receive() never calls
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = cq_entries;
+    }
+
+    int fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0) {
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(fd); // kernels older than 5.4, not worth supporting
+        return false;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    ring.ring_size = std::max(sq_size, cq_size);
+    ring.ring_ptr = mmap(nullptr, ring.ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring.ring_ptr == MAP_FAILED) {
+        ring.ring_ptr = nullptr;
+        close(fd);
+        return false;
+    }
+
+    ring.sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, ring.sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        munmap(ring.ring_ptr, ring.ring_size);
+        ring.ring_ptr = nullptr;
+        close(fd);
+        return false;
+    }
+
+    auto base = static_cast<char*>(ring.ring_ptr);
+    ring.fd = fd;
+    ring.entries = params.sq_entries;
+    ring.sq_head = reinterpret_cast<unsigned*>(base + params.sq_off.head);
+    ring.sq_tail = reinterpret_cast<unsigned*>(base + params.sq_off.tail);
+    ring.sq_mask = reinterpret_cast<unsigned*>(base + params.sq_off.ring_mask);
+    ring.sq_array = reinterpret_cast<unsigned*>(base + params.sq_off.array);
+    ring.sqes = static_cast<io_uring_sqe*>(sqes);
+    ring.cq_head = reinterpret_cast<unsigned*>(base + params.cq_off.head);
+    ring.cq_tail = reinterpret_cast<unsigned*>(base + params.cq_off.tail);
+    ring.cq_mask = reinterpret_cast<unsigned*>(base + params.cq_off.ring_mask);
+    ring.cqes = reinterpret_cast<io_uring_cqe*>(base + params.cq_off.cqes);
+    return true;
+}
+
+void IoUringBackend::destroy_ring(Ring& ring) {
+    if (ring.sqes != nullptr) {
+        munmap(ring.sqes, ring.sqes_size);
+    }
+    if (ring.ring_ptr != nullptr) {
+        munmap(ring.ring_ptr, ring.ring_size);
+    }
+    if (ring.fd >= 0) {
+        close(ring.fd); // also cancels whatever is still posted
+    }
+    ring = Ring();
+}
+
+io_uring_sqe* IoUringBackend::next_sqe(Ring& ring) {
+    unsigned head = __atomic_load_n(ring.sq_head, __ATOMIC_ACQUIRE);
+    unsigned tail = *ring.sq_tail;
+    if (tail - head >= ring.entries) {
+        return nullptr; // submission queue full
+    }
+
+    unsigned index = tail & *ring.sq_mask;
+    io_uring_sqe* sqe = &ring.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring.sq_array[index] = index;
+    // no SQPOLL: the kernel only reads the queue inside io_uring_enter, after the caller filled the sqe
+    __atomic_store_n(ring.sq_tail, tail + 1, __ATOMIC_RELEASE);
+    return sqe;
+}
+
+int IoUringBackend::submit(Ring& ring, unsigned to_submit, unsigned min_complete) {
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int ret;
+    do {
+        enter_calls.fetch_add(1, std::memory_order_relaxed);
+        ret = syscall(__NR_io_uring_enter, ring.fd, to_submit, min_complete, flags, nullptr, 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret;
+}
+
+bool IoUringBackend::setup_receive(size_t size) {
+    if (!setup_ring(recv_ring, RECV_RING_ENTRIES, RECV_CQ_ENTRIES)) {
+        return false;
+    }
+
+    // each buffer gets the io_uring_recvmsg_out header, then the source address, then the datagram
+    memset(&recv_msg, 0, sizeof(recv_msg));
+    recv_msg.msg_namelen = sizeof(sockaddr_in);
+    buffer_size = size;
+    buffer_stride = sizeof(io_uring_recvmsg_out) + sizeof(sockaddr_in) + size;
+    buffer_count = RECV_BUFFER_COUNT;
+    buffers.assign(buffer_stride * buffer_count, std::byte{0});
+
+    // the provided buffer ring must be page aligned
+    buffer_ring_size = buffer_count * sizeof(io_uring_buf);
+    void* ring_memory = mmap(nullptr, buffer_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring_memory == MAP_FAILED) {
+        destroy_ring(recv_ring);
+        return false;
+    }
+    buffer_ring = static_cast<io_uring_buf*>(ring_memory);
+
+    io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buffer_ring);
+    reg.ring_entries = buffer_count;
+    reg.bgid = RECV_BUFFER_GROUP;
+    if (syscall(__NR_io_uring_register, recv_ring.fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        destroy_receive(); // kernel older than 5.19
+        return false;
+    }
+
+    buffer_tail = 0;
+    for (unsigned i = 0; i < buffer_count; i++) {
+        recycle_buffer(static_cast<uint16_t>(i));
+    }
+
+    if (!arm_multishot_recvmsg()) {
+        destroy_receive();
+        return false;
+    }
+
+    // kernels without multishot recvmsg reject it right away
+    unsigned head = *recv_ring.cq_head;
+    if (head != __atomic_load_n(recv_ring.cq_tail, __ATOMIC_ACQUIRE)) {
+        io_uring_cqe* cqe = &recv_ring.cqes[head & *recv_ring.cq_mask];
+        if (cqe->res < 0 && cqe->res != -ENOBUFS) {
+            destroy_receive();
+            return false;
+        }
+    }
+    return true;
+}
+
+void IoUringBackend::destroy_receive() {
+    destroy_ring(recv_ring); // closing the ring cancels the multishot recvmsg and unregisters the buffers
+    if (buffer_ring != nullptr) {
+        munmap(buffer_ring, buffer_ring_size);
+        buffer_ring = nullptr;
+    }
+    buffers.clear();
+    recv_armed = false;
+}
+
+bool IoUringBackend::arm_multishot_recvmsg() {
+    io_uring_sqe* sqe = next_sqe(recv_ring);
+    if (sqe == nullptr) {
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = sockfd;
+    sqe->addr = reinterpret_cast<uint64_t>(&recv_msg);
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = RECV_BUFFER_GROUP;
+    sqe->user_data = RECV_USER_DATA;
+
+    recv_armed = submit(recv_ring, 1, 0) >= 0;
+    return recv_armed;
+}
+
+bool IoUringBackend::cancel_sends() {
+    io_uring_sqe* sqe = next_sqe(send_ring);
+    if (sqe == nullptr) {
+        return false;
+    }
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data = CANCEL_USER_DATA;
+    if (submit(send_ring, 1, 0) < 1) {
+        __atomic_store_n(send_ring.sq_tail, __atomic_load_n(send_ring.sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        return false;
+    }
+    return true;
+}
+
+void IoUringBackend::recycle_buffer(uint16_t buffer_id) {
+    io_uring_buf* buf = &buffer_ring[buffer_tail & (buffer_count - 1)];
+    buf->addr = reinterpret_cast<uint64_t>(buffers.data() + static_cast<size_t>(buffer_id) * buffer_stride);
+    buf->len = static_cast<uint32_t>(buffer_stride);
+    buf->bid = buffer_id;
+    buffer_tail++;
+    __atomic_store_n(&buffer_ring[0].resv, buffer_tail, __ATOMIC_RELEASE);
+}
+
+ssize_t IoUringBackend::receive(std::byte* out, size_t capacity, sockaddr_in* from) {
+    if (capacity > buffer_size) {
+        // bigger datagrams expected (max datagram size grew): rebuilds the pool
+        destroy_receive();
+        if (!setup_receive(capacity)) {
+            return -1;
+        }
+    }
+
+    if (!recv_armed && !arm_multishot_recvmsg()) {
+        return -1;
+    }
+
+    unsigned head = *recv_ring.cq_head;
+    unsigned tail = __atomic_load_n(recv_ring.cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail) {
+        io_uring_cqe* cqe = &recv_ring.cqes[head & *recv_ring.cq_mask];
+        int res = cqe->res;
+        unsigned flags = cqe->flags;
+        __atomic_store_n(recv_ring.cq_head, ++head, __ATOMIC_RELEASE);
+
+        if (!(flags & IORING_CQE_F_MORE)) {
+            recv_armed = false; // the multishot recvmsg ended (e.g. out of buffers), posted again below
+        }
+
+        if (res < 0 || !(flags & IORING_CQE_F_BUFFER)) {
+            continue;
+        }
+
+        uint16_t buffer_id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+        const std::byte* buffer = buffers.data() + static_cast<size_t>(buffer_id) * buffer_stride;
+        io_uring_recvmsg_out header;
+        memcpy(&header, buffer, sizeof(header));
+
+        memset(from, 0, sizeof(*from));
+        memcpy(from, buffer + sizeof(header), std::min<size_t>(header.namelen, sizeof(*from)));
+        // payloadlen is the datagram size even when it was truncated to fit the buffer
+        size_t received = std::min<size_t>({header.payloadlen, buffer_size, capacity});
+        memcpy(out, buffer + sizeof(header) + recv_msg.msg_namelen + recv_msg.msg_controllen, received);
+        recycle_buffer(buffer_id);
+
+        if (!recv_armed) {
+            arm_multishot_recvmsg();
+        }
+        return static_cast<ssize_t>(received);
+    }
+
+    if (!recv_armed) {
+        arm_multishot_recvmsg();
+    }
+    return -1;
+}
+
+size_t IoUringBackend::send_batch(const std::vector<std::byte>* datagrams, size_t count, const sockaddr_in& to) {
+    size_t sent = 0;
+
+    for (size_t offset = 0; offset < count; offset += SEND_RING_ENTRIES) {
+        unsigned chunk = static_cast<unsigned>(std::min<size_t>(count - offset, SEND_RING_ENTRIES));
+
+        unsigned queued = 0;
+        while (queued < chunk) {
+            io_uring_sqe* sqe = next_sqe(send_ring);
+            if (sqe == nullptr) {
+                break; // queue full. Every call drains its own sends, so only the part queued goes
+            }
+
+            const auto& datagram = datagrams[offset + queued];
+            send_iovs[queued].iov_base = const_cast<std::byte*>(datagram.data());
+            send_iovs[queued].iov_len = datagram.size();
+
+            msghdr& msg = send_msgs[queued];
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_name = const_cast<sockaddr_in*>(&to);
+            msg.msg_namelen = sizeof(to);
+            msg.msg_iov = &send_iovs[queued];
+            msg.msg_iovlen = 1;
+
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->fd = sockfd;
+            sqe->addr = reinterpret_cast<uint64_t>(&msg);
+            sqe->len = 1;
+            sqe->user_data = queued;
+            send_results[queued] = -1;
+            queued++;
+        }
+        if (queued == 0) {
+            break;
+        }
+
+        // the kernel may take only part of the queue: submits until it took every sqe, or gives back
+        // the ones it did not take, so no sqe pointing at send_msgs outlives this call
+        unsigned submitted = 0;
+        while (submitted < queued) {
+            int ret = submit(send_ring, queued - submitted, 0);
+            if (ret <= 0) {
+                break; // e.g. EAGAIN/EBUSY: the rest goes back to the caller as not sent
+            }
+            submitted += ret;
+        }
+        if (submitted < queued) {
+            __atomic_store_n(send_ring.sq_tail, __atomic_load_n(send_ring.sq_head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+        }
+
+        // waits for the completion of everything submitted, reading only the completions the kernel published.
+        // The sqes point at send_msgs, send_iovs, to and the caller's datagrams, so none may outlive this call:
+        // if waiting fails (submit already retries EINTR), what is in flight is cancelled and still waited for
+        unsigned completed = 0;
+        bool cancelling = false;
+        while (completed < submitted) {
+            unsigned head = *send_ring.cq_head;
+            unsigned tail = __atomic_load_n(send_ring.cq_tail, __ATOMIC_ACQUIRE);
+            if (head == tail) {
+                if (submit(send_ring, 0, submitted - completed) < 0 && errno != EAGAIN && errno != EBUSY) {
+                    if (!cancelling) {
+                        cancelling = cancel_sends();
+                    } else {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(RING_RETRY_MS));
+                    }
+                }
+                continue;
+            }
+
+            for (; head != tail; head++) {
+                io_uring_cqe* cqe = &send_ring.cqes[head & *send_ring.cq_mask];
+                if (cqe->user_data < SEND_RING_ENTRIES) {
+                    send_results[cqe->user_data] = cqe->res;
+                    completed++;
+                }
+            }
+            __atomic_store_n(send_ring.cq_head, head, __ATOMIC_RELEASE);
+        }
+
+        // completions come in any order: everything up to the last datagram that went out counts as sent, so the
+        // caller never gives its seqnum to another datagram. A failed one before it is lost like on the network
+        unsigned went_out = 0;
+        for (unsigned i = 0; i < submitted; i++) {
+            if (send_results[i] >= 0) {
+                went_out = i + 1;
+            }
+        }
+        sent += went_out;
+        if (went_out < chunk) {
+            return sent;
+        }
+    }
+
+    return sent;
+}
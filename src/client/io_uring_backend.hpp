@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+struct io_uring_buf;
+
+// io_uring backend used by UdpClient (private to the client module).
+//
+// Uses two rings, so the listener thread (receives) and the Transaction thread (sends)
+// never share a submission queue:
+// - receive ring: one multishot recvmsg, kept posted, that fills buffers of a provided
+//   buffer ring (a registered pool of fixed size buffers). Receiving a datagram costs no syscall:
+//   the completion is read from the shared memory queue and the buffer goes back to the pool.
+// - send ring: sendmsg requests queued and submitted in batches with a single io_uring_enter.
+//
+// Built on the raw syscalls (no liburing), needs Linux 6.0+ (multishot recvmsg). create() returns
+// nullptr when the kernel does not support it, so the caller can fall back to sendto/recvfrom.
+class IoUringBackend {
+    public:
+        static IoUringBackend* create(int sockfd, size_t buffer_size);
+        ~IoUringBackend();
+
+        // receive side (single thread). Copies the next datagram into out, its source address into from,
+        // and returns its size, or -1 if nothing was received yet. Never blocks
+        ssize_t receive(std::byte* out, size_t capacity, sockaddr_in* from);
+
+        // ring fd to poll for receive completions (POLLIN once a datagram is waiting), -1 while no
+        // receive is posted (the next receive() posts it again)
+        int receive_wait_fd() const { return recv_armed ? recv_ring.fd : -1; }
+
+        // send side (single thread). Sends count datagrams to the address with one submission per
+        // SEND_RING_ENTRIES datagrams, waits for all of them to complete (none is in flight once it
+        // returns), and returns how many count as sent: the first ones, up to the last one that went out.
+        // A datagram that failed before that one is lost, the caller recovers it like a network loss
+        size_t send_batch(const std::vector<std::byte>* datagrams, size_t count, const sockaddr_in& to);
+
+        // io_uring_enter calls made so far (both rings)
+        uint64_t syscalls() const { return enter_calls.load(std::memory_order_relaxed); }
+
+    private:
+        struct Ring {
+            int fd = -1;
+            unsigned entries = 0;
+            unsigned* sq_head = nullptr;
+            unsigned* sq_tail = nullptr;
+            unsigned* sq_mask = nullptr;
+            unsigned* sq_array = nullptr;
+            io_uring_sqe* sqes = nullptr;
+            unsigned* cq_head = nullptr;
+            unsigned* cq_tail = nullptr;
+            unsigned* cq_mask = nullptr;
+            io_uring_cqe* cqes = nullptr;
+            void* ring_ptr = nullptr;
+            size_t ring_size = 0;
+            size_t sqes_size = 0;
+        };
+
+        int sockfd;
+        std::atomic<uint64_t> enter_calls {0};
+        Ring recv_ring;
+        Ring send_ring;
+        std::vector<msghdr> send_msgs; // one per queued send, reused by every batch
+        std::vector<iovec> send_iovs;
+        std::vector<int> send_results; // completion result of each send of the chunk in flight
+
+        // provided buffer pool for the receive ring. Used as a plain io_uring_buf array:
+        // io_uring_buf_ring is declared with a C flexible array trick that has a different layout in C++.
+        // The ring tail lives in the resv field of the first entry
+        io_uring_buf* buffer_ring = nullptr;
+        size_t buffer_ring_size = 0;
+        std::vector<std::byte> buffers;
+        size_t buffer_size = 0; // datagram capacity of each buffer
+        size_t buffer_stride = 0; // recvmsg header + source address + datagram
+        msghdr recv_msg; // layout of the multishot recvmsg (address size, no control data)
+        unsigned buffer_count = 0;
+        uint16_t buffer_tail = 0;
+        bool recv_armed = false;
+
+        IoUringBackend(int sockfd);
+
+        static bool setup_ring(Ring& ring, unsigned entries, unsigned cq_entries = 0);
+        static void destroy_ring(Ring& ring);
+        static io_uring_sqe* next_sqe(Ring& ring);
+        int submit(Ring& ring, unsigned to_submit, unsigned min_complete);
+
+        // (re)creates the receive ring and its buffer pool, sized for datagrams of size bytes
+        bool setup_receive(size_t size);
+        void destroy_receive();
+        bool arm_multishot_recvmsg();
+        // cancels every send still in flight on the send ring (their completions still arrive)
+        bool cancel_sends();
+        void recycle_buffer(uint16_t buffer_id);
+};
@@ -5,19 +5,46 @@
 #include <netdb.h>
 #include <unistd.h> 
 #include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <thread>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <poll.h>
 #include "logger.hpp"   
+#include "io_uring_backend.hpp"
 
-UdpClient::UdpClient(const std::string& host, int port)
-    : host(host), port(port), sockfd(-1), is_connected(false) {
+#define DEFAULT_MAX_DATAGRAM_SIZE 1472 // 1500 bytes ethernet MTU - 20 bytes IPv4 header - 8 bytes UDP header
+#define MAX_UDP_PAYLOAD 65507 // 65535 - IPv4 header - UDP header
+#define IP_UDP_HEADERS_SIZE 28
+#define PMTU_PROBE_WAIT_MS 50 // time given to ICMP "fragmentation needed" replies to arrive
+#define GSO_MAX_SEGMENTS 64 // UDP_MAX_SEGMENTS of the kernel: datagrams per offloaded send
+
+UdpClient::UdpClient(const std::string& host, int port, UdpBackend backend)
+    : UdpClient(std::vector<Endpoint>{Endpoint{host, port}}, backend) {
+}
+
+UdpClient::UdpClient(const std::vector<Endpoint>& endpoints, UdpBackend backend)
+    : UdpClient(std::make_shared<EndpointSet>(endpoints), backend) {
+}
+
+UdpClient::UdpClient(std::shared_ptr<EndpointSet> endpoints, UdpBackend backend)
+    : endpoints(std::move(endpoints)), current_endpoint(0), sockfd(-1), is_connected(false),
+      max_datagram_size(DEFAULT_MAX_DATAGRAM_SIZE), backend(backend), uring(nullptr), io_syscalls(0),
+      send_offload(false), receive_offload(false), coalesced_length(0), coalesced_offset(0), coalesced_segment(0) {
     // Inicializa a estrutura de endereço do servidor com zeros
     memset(&servaddr, 0, sizeof(servaddr));
     memset(&listening_address, 0, sizeof(listening_address));
     listening_address.sin_family = AF_INET;
     listening_address.sin_addr.s_addr = INADDR_ANY;
-    listening_address.sin_port = htons(port);
+    if (this->endpoints->size() > 0) {
+        listening_address.sin_port = htons(this->endpoints->endpoint(0).port);
+    }
 }
 
 UdpClient::~UdpClient() {
+    delete uring;
     if (sockfd != -1) {
         close(sockfd);
     }
@@ -30,19 +57,35 @@ bool UdpClient::setupConnection() {
         return false;
     }
 
-    // 2. Configurar o endereço do servidor
-    memset(&servaddr, 0, sizeof(servaddr));
-    servaddr.sin_family = AF_INET;
-    servaddr.sin_port = htons(port);
-    if (inet_pton(AF_INET, host.c_str(), &servaddr.sin_addr) <= 0) {
-        perror("inet_pton failed");
+    // 2. Configurar o endereço do servidor (todos os endpoints precisam ser validos)
+    for (size_t i = 0; i < endpoints->size(); i++) {
+        if (!endpoints->address(i, &servaddr)) {
+            std::cerr << "Endereco invalido: " << endpoints->endpoint(i).toString() << std::endl;
+            close(sockfd);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (endpoints->size() == 0) {
+        std::cerr << "Nenhum endpoint configurado" << std::endl;
         close(sockfd);
         exit(EXIT_FAILURE);
     }
+    current_endpoint = endpoints->best();
+    endpoints->address(current_endpoint, &servaddr);
     
+    if (backend == UdpBackend::IO_URING) {
+        uring = IoUringBackend::create(sockfd, max_datagram_size);
+        if (uring == nullptr) {
+            Log(LogLevel::WARNING, "io_uring nao suportado pelo kernel, usando sendto/recvfrom");
+            backend = UdpBackend::SOCKET;
+        }
+    }
+
     this->is_connected = true;
 
-    Log(LogLevel::INFO, "Conexao UDP configurada para " + host + ":" + std::to_string(port));
+    Log(LogLevel::INFO, "Conexao UDP configurada para " + currentEndpoint().toString()
+        + (endpoints->size() > 1 ? " (" + std::to_string(endpoints->size()) + " endpoints)" : "")
+        + (backend == UdpBackend::IO_URING ? " (io_uring)" : ""));
     Log(LogLevel::INFO, "is_connected: " + std::to_string(is_connected));
     return true;
 }
@@ -65,6 +108,223 @@ bool UdpClient::setReceiveTimeout(long seconds, long microseconds) {
     return true;
 }
 
+bool UdpClient::setSendOffload(bool enabled) {
+    if (!is_connected) {
+        std::cerr << "Erro: Socket nao conectado." << std::endl;
+        return false;
+    }
+    if (!enabled) {
+        send_offload = false;
+        return true;
+    }
+    if (uring != nullptr) {
+        Log(LogLevel::WARNING, "GSO disponivel apenas no backend SOCKET");
+        return false;
+    }
+
+    // a default segment size of 0 keeps every plain send as is, it only checks that the kernel knows UDP_SEGMENT
+    int no_segmentation = 0;
+    if (setsockopt(sockfd, SOL_UDP, UDP_SEGMENT, &no_segmentation, sizeof(no_segmentation)) < 0) {
+        perror("UDP_SEGMENT nao suportado");
+        return false;
+    }
+    send_offload = true;
+    return true;
+}
+
+bool UdpClient::setReceiveOffload(bool enabled) {
+    if (!is_connected) {
+        std::cerr << "Erro: Socket nao conectado." << std::endl;
+        return false;
+    }
+    if (enabled && uring != nullptr) {
+        Log(LogLevel::WARNING, "GRO disponivel apenas no backend SOCKET");
+        return false;
+    }
+
+    int value = enabled ? 1 : 0;
+    if (setsockopt(sockfd, SOL_UDP, UDP_GRO, &value, sizeof(value)) < 0) {
+        perror("UDP_GRO nao suportado");
+        return false;
+    }
+    if (enabled) {
+        coalesced_buffer.resize(MAX_UDP_PAYLOAD); // a coalesced buffer can be as big as any datagram
+    }
+    receive_offload = enabled;
+    return true;
+}
+
+int UdpClient::setBufferSize(int force_option, int option, int bytes) {
+    if (!is_connected) {
+        std::cerr << "Erro: Socket nao conectado." << std::endl;
+        return -1;
+    }
+
+    if (setsockopt(sockfd, SOL_SOCKET, force_option, &bytes, sizeof(bytes)) < 0
+            && setsockopt(sockfd, SOL_SOCKET, option, &bytes, sizeof(bytes)) < 0) {
+        perror("Falha ao definir o tamanho do buffer do socket");
+        return -1;
+    }
+
+    int actual = 0;
+    socklen_t len = sizeof(actual);
+    if (getsockopt(sockfd, SOL_SOCKET, option, &actual, &len) < 0) {
+        perror("Falha ao ler o tamanho do buffer do socket");
+        return -1;
+    }
+    if (actual < bytes) {
+        Log(LogLevel::WARNING, "buffer do socket limitado pelo kernel a " + std::to_string(actual) + " bytes (pedido: " + std::to_string(bytes) + ")");
+    }
+    return actual;
+}
+
+int UdpClient::setSendBufferSize(int bytes) {
+    return setBufferSize(SO_SNDBUFFORCE, SO_SNDBUF, bytes);
+}
+
+int UdpClient::setReceiveBufferSize(int bytes) {
+    return setBufferSize(SO_RCVBUFFORCE, SO_RCVBUF, bytes);
+}
+
+uint64_t UdpClient::getSyscallCount() const {
+    return io_syscalls.load(std::memory_order_relaxed) + (uring != nullptr ? uring->syscalls() : 0);
+}
+
+void UdpClient::setMaxDatagramSize(size_t size) {
+    this->max_datagram_size = std::min<size_t>(size, MAX_UDP_PAYLOAD);
+}
+
+size_t UdpClient::getMaxDatagramSize() const {
+    return this->max_datagram_size;
+}
+
+UdpBackend UdpClient::getBackend() const {
+    return this->backend;
+}
+
+void UdpClient::selectEndpoint() {
+    size_t best = endpoints->best();
+    if (best != current_endpoint) {
+        current_endpoint = best;
+        endpoints->address(current_endpoint, &servaddr);
+        Log(LogLevel::INFO, "usando o endpoint " + currentEndpoint().toString());
+    }
+}
+
+bool UdpClient::failover() {
+    if (endpoints->size() < 2) {
+        return false; // nowhere to go, the retransmissions keep going to the only server
+    }
+
+    endpoints->mark_down(current_endpoint);
+    size_t next = endpoints->next_best(current_endpoint);
+    if (next == current_endpoint) {
+        return false;
+    }
+
+    Log(LogLevel::WARNING, "endpoint " + currentEndpoint().toString() + " sem resposta, trocando para " + endpoints->endpoint(next).toString());
+    current_endpoint = next;
+    endpoints->address(current_endpoint, &servaddr);
+    return true;
+}
+
+void UdpClient::reportResponse(std::chrono::microseconds rtt) {
+    endpoints->on_response(current_endpoint, rtt);
+}
+
+void UdpClient::reportTimeout() {
+    endpoints->on_timeout(current_endpoint);
+}
+
+std::chrono::microseconds UdpClient::responseTimeout(std::chrono::microseconds fallback) const {
+    return endpoints->response_timeout(current_endpoint, fallback);
+}
+
+bool UdpClient::fromCurrentEndpoint(const sockaddr_in& from) const {
+    sockaddr_in expected;
+    if (!endpoints->address(current_endpoint, &expected)) {
+        return false;
+    }
+    return from.sin_addr.s_addr == expected.sin_addr.s_addr && from.sin_port == expected.sin_port;
+}
+
+const Endpoint& UdpClient::currentEndpoint() const {
+    return endpoints->endpoint(current_endpoint);
+}
+
+std::shared_ptr<EndpointSet> UdpClient::getEndpoints() const {
+    return endpoints;
+}
+
+size_t UdpClient::discoverMaxDatagramSize(const std::vector<std::byte>& probe_header) {
+    if (!is_connected) {
+        std::cerr << "Erro: Socket nao conectado." << std::endl;
+        return 0;
+    }
+
+    // separate connected socket: IP_MTU is only available on connected sockets,
+    // and the probes must not change the options of the data socket
+    int probefd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (probefd < 0) {
+        perror("Falha ao criar socket de probe");
+        return 0;
+    }
+
+    if (connect(probefd, (const struct sockaddr *)&servaddr, sizeof(servaddr)) < 0) {
+        perror("connect do socket de probe falhou");
+        close(probefd);
+        return 0;
+    }
+
+    // PROBE: sets DF but ignores the cached path MTU, so the probes are sent even if they are too big
+    int discover = IP_PMTUDISC_PROBE;
+    int mtu = 0;
+    socklen_t mtu_len = sizeof(mtu);
+    if (setsockopt(probefd, IPPROTO_IP, IP_MTU_DISCOVER, &discover, sizeof(discover)) < 0
+            || getsockopt(probefd, IPPROTO_IP, IP_MTU, &mtu, &mtu_len) < 0) {
+        perror("Falha ao ler o MTU da rota");
+        close(probefd);
+        return 0;
+    }
+    if (mtu <= IP_UDP_HEADERS_SIZE || static_cast<size_t>(mtu - IP_UDP_HEADERS_SIZE) < probe_header.size()) {
+        std::cerr << "Erro: MTU da rota muito pequeno (" << mtu << " bytes)." << std::endl;
+        close(probefd);
+        return 0;
+    }
+
+    // probe packets: the largest one the route accepts, plus the usual ethernet and IPv6 minimum sizes.
+    // If any hop is smaller, its ICMP "fragmentation needed" lowers the kernel's path MTU for the server.
+    // Each probe is probe_header padded with zeros, so the server gets something it can parse and drop
+    size_t route_payload = std::min<size_t>(mtu - IP_UDP_HEADERS_SIZE, MAX_UDP_PAYLOAD);
+    std::vector<std::byte> probe(route_payload, std::byte{0});
+    std::copy(probe_header.begin(), probe_header.end(), probe.begin());
+    for (size_t size : {route_payload, size_t(1500 - IP_UDP_HEADERS_SIZE), size_t(1280 - IP_UDP_HEADERS_SIZE)}) {
+        if (size <= route_payload && size >= probe_header.size()
+                && send(probefd, probe.data(), size, 0) < 0 && errno != EMSGSIZE) {
+            perror("Falha ao enviar probe de MTU");
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(PMTU_PROBE_WAIT_MS));
+
+    // DO: now IP_MTU reports the path MTU, including what the probes taught the kernel
+    discover = IP_PMTUDISC_DO;
+    mtu_len = sizeof(mtu);
+    if (setsockopt(probefd, IPPROTO_IP, IP_MTU_DISCOVER, &discover, sizeof(discover)) < 0
+            || getsockopt(probefd, IPPROTO_IP, IP_MTU, &mtu, &mtu_len) < 0) {
+        perror("Falha ao ler o MTU do caminho");
+        close(probefd);
+        return 0;
+    }
+    close(probefd);
+    if (mtu <= IP_UDP_HEADERS_SIZE) {
+        std::cerr << "Erro: MTU do caminho muito pequeno (" << mtu << " bytes)." << std::endl;
+        return 0;
+    }
+
+    size_t discovered = std::min<size_t>(mtu - IP_UDP_HEADERS_SIZE, MAX_UDP_PAYLOAD);
+    Log(LogLevel::INFO, "path MTU para " + currentEndpoint().host + ": " + std::to_string(mtu) + " (max datagram " + std::to_string(discovered) + " bytes)");
+    return discovered;
+}
 
 bool UdpClient::send_chars(const std::vector<char>& data) {
     if (!is_connected) {
@@ -90,7 +350,12 @@ bool UdpClient::send_bytes(const std::vector<std::byte>& data) {
         return false;
     }
 
+    if (uring != nullptr) {
+        return uring->send_batch(&data, 1, servaddr) == 1;
+    }
+
     // sendto envia os dados para o endereço de servidor configurado
+    io_syscalls.fetch_add(1, std::memory_order_relaxed);
     ssize_t bytes_sent = sendto(sockfd, data.data(), data.size(), 0, 
                                 (const struct sockaddr *)&servaddr, sizeof(servaddr));
 
@@ -102,23 +367,148 @@ bool UdpClient::send_bytes(const std::vector<std::byte>& data) {
     return true;
 }
 
+size_t UdpClient::send_bytes_batch(const std::vector<std::byte>* datagrams, size_t count) {
+    if (!is_connected) {
+        std::cerr << "Erro: Socket nao conectado." << std::endl;
+        return 0;
+    }
+
+    if (uring != nullptr) {
+        return uring->send_batch(datagrams, count, servaddr);
+    }
+    if (send_offload && count > 1) {
+        return sendSegmented(datagrams, count);
+    }
+
+    if (send_msgs.size() < count) {
+        send_msgs.resize(count);
+        send_iovs.resize(count);
+    }
+    for (size_t i = 0; i < count; i++) {
+        send_iovs[i].iov_base = const_cast<std::byte*>(datagrams[i].data());
+        send_iovs[i].iov_len = datagrams[i].size();
+
+        memset(&send_msgs[i], 0, sizeof(send_msgs[i]));
+        send_msgs[i].msg_hdr.msg_name = &servaddr;
+        send_msgs[i].msg_hdr.msg_namelen = sizeof(servaddr);
+        send_msgs[i].msg_hdr.msg_iov = &send_iovs[i];
+        send_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    // sendmmsg may stop early (e.g. full socket buffer), so it is called until everything is sent
+    size_t sent = 0;
+    while (sent < count) {
+        io_syscalls.fetch_add(1, std::memory_order_relaxed);
+        int ret = sendmmsg(sockfd, &send_msgs[sent], count - sent, 0);
+        if (ret <= 0) {
+            perror("Falha no envio de dados");
+            break;
+        }
+        sent += ret;
+    }
+    return sent;
+}
+
+size_t UdpClient::sendSegmented(const std::vector<std::byte>* datagrams, size_t count) {
+    const size_t control_size = CMSG_SPACE(sizeof(uint16_t));
+    // each buffer against its own size: plain batches grow send_msgs and send_iovs only
+    if (send_msgs.size() < count) {
+        send_msgs.resize(count);
+    }
+    if (send_iovs.size() < count) {
+        send_iovs.resize(count);
+    }
+    if (send_runs.size() < count) {
+        send_runs.resize(count);
+    }
+    if (send_controls.size() < count * control_size) {
+        send_controls.resize(count * control_size);
+    }
+
+    // runs of datagrams of the same size (only the last one of a run may be shorter), each run
+    // is one message: its datagrams are the iovecs, UDP_SEGMENT tells the kernel where to cut
+    size_t messages = 0;
+    for (size_t first = 0; first < count;) {
+        size_t segment = datagrams[first].size();
+        size_t run = 0;
+        size_t bytes = 0;
+        while (first + run < count && run < GSO_MAX_SEGMENTS) {
+            size_t size = datagrams[first + run].size();
+            if (size > segment || bytes + size > MAX_UDP_PAYLOAD) {
+                break;
+            }
+            send_iovs[first + run].iov_base = const_cast<std::byte*>(datagrams[first + run].data());
+            send_iovs[first + run].iov_len = size;
+            bytes += size;
+            run++;
+            if (size < segment || segment == 0) {
+                break; // a shorter datagram ends the run
+            }
+        }
+
+        msghdr& msg = send_msgs[messages].msg_hdr;
+        memset(&send_msgs[messages], 0, sizeof(send_msgs[messages]));
+        msg.msg_name = &servaddr;
+        msg.msg_namelen = sizeof(servaddr);
+        msg.msg_iov = &send_iovs[first];
+        msg.msg_iovlen = run;
+        if (run > 1) {
+            msg.msg_control = &send_controls[messages * control_size];
+            msg.msg_controllen = control_size;
+            cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            uint16_t segment_size = static_cast<uint16_t>(segment);
+            memcpy(CMSG_DATA(cmsg), &segment_size, sizeof(segment_size));
+        }
+        send_runs[messages++] = run;
+        first += run;
+    }
+
+    size_t sent_messages = 0;
+    size_t sent = 0;
+    while (sent_messages < messages) {
+        io_syscalls.fetch_add(1, std::memory_order_relaxed);
+        int ret = sendmmsg(sockfd, &send_msgs[sent_messages], messages - sent_messages, 0);
+        if (ret <= 0) {
+            if (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT) {
+                // e.g. a device without checksum offload: the rest goes as plain datagrams from now on
+                perror("GSO recusado, desativando");
+                send_offload = false;
+                return sent + send_bytes_batch(datagrams + sent, count - sent);
+            }
+            perror("Falha no envio de dados");
+            break;
+        }
+        for (int i = 0; i < ret; i++) {
+            sent += send_runs[sent_messages + i];
+        }
+        sent_messages += ret;
+    }
+    return sent;
+}
+
 std::vector<char> UdpClient::receive_chars(int buffer_size) {
     if (!is_connected) {
         std::cerr << "Erro: Socket nao conectado." << std::endl;
         return {};
     }
 
-    std::vector<char> buffer(buffer_size);
-    socklen_t len = sizeof(servaddr);
+    std::vector<char> buffer(buffer_size > 0 ? buffer_size : max_datagram_size.load());
+    socklen_t len = sizeof(clientaddr);
 
     // recvfrom aguarda por dados
     ssize_t bytes_received = recvfrom(sockfd, buffer.data(), buffer.size(), 0, 
-                                      (struct sockaddr *)&servaddr, &len);
+                                      (struct sockaddr *)&clientaddr, &len);
 
     if (bytes_received < 0) {
         perror("Falha no recebimento de dados (ou timeout)");
         return {};
     }
+    if (!fromCurrentEndpoint(clientaddr)) {
+        return {};
+    }
 
     // Redimensiona o buffer para o tamanho real de dados recebidos
     buffer.resize(bytes_received);
@@ -127,25 +517,107 @@ std::vector<char> UdpClient::receive_chars(int buffer_size) {
 
 
 std::vector<std::byte> UdpClient::receive_bytes(int buffer_size) {
-        if (!is_connected) {
+    // the receive buffer is kept between calls, only the received bytes are copied out
+    if (receive_bytes(receive_buffer, buffer_size) < 0) {
+        return {}; // Retorna um buffer vazio em caso de falha
+    }
+    return receive_buffer;
+}
+
+ssize_t UdpClient::receive_bytes(std::vector<std::byte>& out, int buffer_size) {
+    if (!is_connected) {
         std::cerr << "Erro: Socket nao conectado." << std::endl;
-        return {};
+        return -1;
     }
 
-    std::vector<std::byte> buffer(buffer_size);
-    socklen_t len = sizeof(servaddr);
+    if (receive_offload || coalesced_offset < coalesced_length) {
+        return receiveCoalesced(out);
+    }
 
-    // recvfrom aguarda por dados
-    ssize_t bytes_received = recvfrom(sockfd, buffer.data(), buffer.size(), MSG_DONTWAIT, 
-                                      (struct sockaddr *)&servaddr, &len);
+    // never shrinks the capacity, so a buffer reused by the caller is allocated only once
+    out.resize(buffer_size > 0 ? buffer_size : max_datagram_size.load());
 
-    if (bytes_received < 0) {
-        // perror("Falha no recebimento de dados (ou timeout)");
-        buffer.resize(0); // Retorna um buffer vazio em caso de falha
-        return buffer;
+    ssize_t bytes_received;
+    if (uring != nullptr) {
+        bytes_received = uring->receive(out.data(), out.size(), &clientaddr);
+    } else {
+        socklen_t len = sizeof(clientaddr);
+
+        // recvfrom aguarda por dados
+        io_syscalls.fetch_add(1, std::memory_order_relaxed);
+        bytes_received = recvfrom(sockfd, out.data(), out.size(), MSG_DONTWAIT,
+                                  (struct sockaddr *)&clientaddr, &len);
     }
 
-    // Redimensiona o buffer para o tamanho real de dados recebidos
-    buffer.resize(bytes_received);
-    return buffer;
-}
\ No newline at end of file
+    if (bytes_received < 0 || !fromCurrentEndpoint(clientaddr)) {
+        out.clear();
+        return -1;
+    }
+
+    out.resize(bytes_received);
+    return bytes_received;
+}
+
+bool UdpClient::waitForData(std::chrono::milliseconds timeout, int wake_fd) {
+    if (coalesced_offset < coalesced_length) {
+        return true; // datagrams of the last coalesced buffer not handed out yet
+    }
+
+    int fd = sockfd;
+    if (uring != nullptr) {
+        fd = uring->receive_wait_fd();
+        if (fd < 0) {
+            return true; // receive_bytes posts the receive again
+        }
+    }
+
+    pollfd fds[2] = {{fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+    io_syscalls.fetch_add(1, std::memory_order_relaxed);
+    int ready = poll(fds, wake_fd >= 0 ? 2 : 1, static_cast<int>(timeout.count()));
+    return ready > 0 && (fds[0].revents & POLLIN);
+}
+
+ssize_t UdpClient::receiveCoalesced(std::vector<std::byte>& out) {
+    if (coalesced_offset >= coalesced_length) {
+        iovec iov {coalesced_buffer.data(), coalesced_buffer.size()};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+        msghdr msg {};
+        msg.msg_name = &clientaddr;
+        msg.msg_namelen = sizeof(clientaddr);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        io_syscalls.fetch_add(1, std::memory_order_relaxed);
+        ssize_t bytes_received = recvmsg(sockfd, &msg, MSG_DONTWAIT);
+        if (bytes_received < 0 || !fromCurrentEndpoint(clientaddr)) {
+            out.clear();
+            return -1;
+        }
+        if (bytes_received == 0) {
+            out.clear();
+            return 0;
+        }
+
+        // without the control message it is a single datagram
+        coalesced_segment = bytes_received;
+        for (cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+                int segment = 0;
+                memcpy(&segment, CMSG_DATA(cmsg), sizeof(segment));
+                if (segment > 0) {
+                    coalesced_segment = segment;
+                }
+            }
+        }
+        coalesced_length = bytes_received;
+        coalesced_offset = 0;
+    }
+
+    // one datagram per call, copied into the caller buffer (its capacity is kept)
+    size_t size = std::min(coalesced_segment, coalesced_length - coalesced_offset);
+    out.assign(coalesced_buffer.begin() + coalesced_offset, coalesced_buffer.begin() + coalesced_offset + size);
+    coalesced_offset += size;
+    return size;
+}
@@ -1,7 +1,23 @@
 #include "logger.hpp"
 
-void Log(LogLevel level, const std::string& msg) {
-    std::string levelStr;
+#include <atomic>
+
+static std::atomic<LogLevel> min_level {LogLevel::INFO};
+
+void setLogLevel(LogLevel level) {
+    min_level.store(level, std::memory_order_relaxed);
+}
+
+bool LogEnabled(LogLevel level) {
+    return level >= min_level.load(std::memory_order_relaxed);
+}
+
+void Log(LogLevel level, std::string_view msg) {
+    if (!LogEnabled(level)) {
+        return;
+    }
+
+    const char* levelStr = "";
     switch (level) {
         case LogLevel::INFO: levelStr = "INFO"; break;
         case LogLevel::WARNING: levelStr = "WARN"; break;
@@ -9,4 +25,4 @@ void Log(LogLevel level, const std::string& msg) {
     }
 
     std::cout << "[" << levelStr << "] " << msg << std::endl;
-}
\ No newline at end of file
+}
@@ -3,51 +3,69 @@
 #include "slow_package.hpp"
 #include "logger.hpp"
 #include "udp_client.hpp"
+#include "endpoint_set.hpp"
 #include "transaction.hpp"
 
-int main() {
+int main(int argc, char** argv) {
     Log(LogLevel::INFO, "starting application");
 
-    std::string host = "142.93.184.175";
-    int port = 7033;
+    // servers given as "host:port" arguments. Each new session goes to the fastest healthy one
+    // and fails over to the next one when it does not answer
+    std::vector<Endpoint> endpoints;
+    for (int i = 1; i < argc; i++) {
+        Endpoint endpoint;
+        if (!parseEndpoint(argv[i], &endpoint)) {
+            Log(LogLevel::ERROR, std::string("invalid endpoint (expected host:port): ") + argv[i]);
+            exit(EXIT_FAILURE);
+        }
+        endpoints.push_back(endpoint);
+    }
+    if (endpoints.empty()) {
+        endpoints.push_back(Endpoint{"142.93.184.175", 7033});
+    }
 
-    UdpClient* client = new UdpClient(host, port);
+    UdpClient* client = new UdpClient(endpoints);
     client->setupConnection();
     client->setReceiveTimeout(0, 10);
         
     Transaction *transaction_manager = new Transaction(client);
 
-    if (!transaction_manager->connect() ) {
-        Log(LogLevel::ERROR, "connect failed. cancelling operation");
+    auto status = transaction_manager->connect(deadlineIn(std::chrono::seconds(5)));
+    if (status != OperationStatus::OK) {
+        Log(LogLevel::ERROR, "connect failed (" + operationStatusToString(status) + "). cancelling operation");
         exit(EXIT_FAILURE);
     }
 
     Log(LogLevel::INFO, "connected to server. sending data");
 
-    if (!transaction_manager->send_data("hello world") ) {
-        Log(LogLevel::ERROR, "data sending failed. cancelling operation");
+    status = transaction_manager->send_data("hello world", false, deadlineIn(std::chrono::seconds(5)));
+    if (status != OperationStatus::OK) {
+        Log(LogLevel::ERROR, "data sending failed (" + operationStatusToString(status) + "). cancelling operation");
         exit(EXIT_FAILURE);
     }
 
     Log(LogLevel::INFO, "data sent successfully. disconnecting");
     
-    if (!transaction_manager->disconnect() ) {
-        Log(LogLevel::ERROR, "disconnect failed. cancelling operation");
+    status = transaction_manager->disconnect(deadlineIn(std::chrono::seconds(5)));
+    if (status != OperationStatus::OK) {
+        Log(LogLevel::ERROR, "disconnect failed (" + operationStatusToString(status) + "). cancelling operation");
         exit(EXIT_FAILURE);
     }
 
     Log(LogLevel::INFO, "disconnected from server. sending more data");
 
-    if (!transaction_manager->send_data("hello world again", true) ) {
-        Log(LogLevel::ERROR, "data sending failed. cancelling operation");
+    status = transaction_manager->send_data("hello world again", true, deadlineIn(std::chrono::seconds(5)));
+    if (status != OperationStatus::OK) {
+        Log(LogLevel::ERROR, "data sending failed (" + operationStatusToString(status) + "). cancelling operation");
         exit(EXIT_FAILURE);
     }
 
     Log(LogLevel::INFO, "data with revive sent successfully. disconnecting again");
     
-    if (!transaction_manager->disconnect() ) {
+    status = transaction_manager->disconnect(deadlineIn(std::chrono::seconds(5)));
+    if (status != OperationStatus::OK) {
+        Log(LogLevel::ERROR, "disconnect failed (" + operationStatusToString(status) + "). cancelling operation");
         exit(EXIT_FAILURE);
-        Log(LogLevel::ERROR, "disconnect failed. cancelling operation");
     }
 
     Log(LogLevel::INFO, "application finished successfully");
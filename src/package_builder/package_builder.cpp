@@ -3,10 +3,12 @@
 
 #include <array>
 #include <cstddef>
+#include <algorithm>
 
 // Return a connect package, receives the window buffer remaining size
 SlowPackage connectPackage(uint16_t window) {
-    auto pkg = new SlowPackage();
+    SlowPackage package;
+    auto pkg = &package; // built on the stack, returned by value
     pkg->type = SlowPackage::PackageType::CONNECT;
     pkg->sid.fill(std::byte(0)); // Initialize sid with zeros
     pkg->sttl = 0; // Set TTL to 0 for connect package  
@@ -21,12 +23,13 @@ SlowPackage connectPackage(uint16_t window) {
     pkg->fid = 0; // Set fid to 0
     pkg->fo = 0; // Set fo to 0
     pkg->data.clear(); // Clear data vector
-    return *pkg; // Return the package
+    return package; // Return the package
 }
 
 // Return a disconnect package, requires session data
 SlowPackage disconnectPackage(std::array<std::byte, 16> sid, uint32_t sttl, uint32_t seqnum, uint32_t acknum){
-    auto pkg = new SlowPackage();
+    SlowPackage package;
+    auto pkg = &package; // built on the stack, returned by value
     pkg->type = SlowPackage::PackageType::DISCONNECT;
     pkg->sid = sid; // Set session ID
     pkg->sttl = sttl; // Set session TTL
@@ -41,7 +44,7 @@ SlowPackage disconnectPackage(std::array<std::byte, 16> sid, uint32_t sttl, uint
     pkg->fid = 0; // Set fid to 0
     pkg->fo = 0; // Set fo to 0
     pkg->data.clear(); // Clear data vector
-    return *pkg; // Return the package
+    return package; // Return the package
 }
 
 // NOTE: when using this function, keep in mind the project documentation
@@ -49,61 +52,52 @@ SlowPackage disconnectPackage(std::array<std::byte, 16> sid, uint32_t sttl, uint
 // implements their logic bases on asssumptions
 //
 // Given some data, returns a vector of SlowPackages
-// fragmented by the max size
+// fragmented by the max size (max_data_size bytes of data per package)
 std::vector<SlowPackage> fragmentedDataPackages(std::array<std::byte, 16> sid, uint32_t sttl, uint32_t seqnum, 
-    uint32_t acknum, uint16_t window, uint8_t fid, std::vector<std::byte> data) {
-        uint32_t unsentBytes = data.size();
-        uint8_t fo = 0; // Fragment offset
+    uint32_t acknum, uint16_t window, uint8_t fid, std::vector<std::byte> data, uint32_t max_data_size) {
         std::vector<SlowPackage> packages; // Vector to hold the packages
-        while (unsentBytes > 1440) {
-            auto pkg = new SlowPackage();
-            pkg->type = SlowPackage::PackageType::DATA;
-            pkg->sid = sid; // Set session ID
-            pkg->sttl = sttl; // Set session TTL
-            pkg->flag_connect = false; // Set connect flag to false
-            pkg->flag_revive = false; // Set revive flag to false
-            pkg->flag_ack = false; // Set ack flag to true
-            pkg->flag_accept_reject = false; // Set accept/reject flag to false
-            pkg->flag_mb = true; // Set mb flag to true
-            pkg->seqnum = seqnum++; // Set sequence number
-            pkg->acknum = acknum; // Set acknowledgment number
-            pkg->window = window--; // Set window size
-            pkg->fid = fid; // Set fid
-            pkg->fo = fo++; // increment fragment offset
-
-            uint32_t dataSize = std::min(unsentBytes, static_cast<uint32_t>(1440)); // Max data size per package is 1440 bytes
-            pkg->data.insert(pkg->data.end(), data.begin() + (data.size() - unsentBytes), data.begin() + (data.size() - unsentBytes + dataSize));
-            
-            unsentBytes -= dataSize;
+        size_t count = fragmentDataPackagesInto(packages, sid, sttl, seqnum, acknum, window, fid, data.data(), data.size(), max_data_size);
+        packages.resize(count);
+        return packages;
+    }
 
-            packages.push_back(*pkg); // Add the package to the vector
+size_t fragmentDataPackagesInto(std::vector<SlowPackage>& packages, const std::array<std::byte, 16>& sid, uint32_t sttl,
+    uint32_t seqnum, uint32_t acknum, uint16_t window, uint8_t fid, const std::byte* data, size_t size, uint32_t max_data_size) {
+        // an empty message is still one (empty) package
+        size_t count = size == 0 ? 1 : (size + max_data_size - 1) / max_data_size;
+        if (packages.size() < count) {
+            packages.resize(count); // grows only, so the payload buffers of earlier calls are reused
         }
-        auto pkg = new SlowPackage();
+
+        size_t sentBytes = 0;
+        for (size_t i = 0; i < count; i++) {
+            SlowPackage* pkg = &packages[i];
             pkg->type = SlowPackage::PackageType::DATA;
             pkg->sid = sid; // Set session ID
             pkg->sttl = sttl; // Set session TTL
             pkg->flag_connect = false; // Set connect flag to false
             pkg->flag_revive = false; // Set revive flag to false
-            pkg->flag_ack = false; // Set ack flag to true
+            pkg->flag_ack = false; // Set ack flag to false
             pkg->flag_accept_reject = false; // Set accept/reject flag to false
-            pkg->flag_mb = false; // Set mb flag to true
+            pkg->flag_mb = i + 1 < count; // more bits follow, except on the last fragment
             pkg->seqnum = seqnum++; // Set sequence number
             pkg->acknum = acknum; // Set acknowledgment number
             pkg->window = window--; // Set window size
             pkg->fid = fid; // Set fid
-            pkg->fo = fo++; // increment fragment offset
+            pkg->fo = static_cast<uint8_t>(i); // fragment offset
 
-            uint32_t dataSize = std::min(unsentBytes, static_cast<uint32_t>(1440)); // Max data size per package is 1440 bytes
-            pkg->data.insert(pkg->data.end(), data.begin() + (data.size() - unsentBytes), data.begin() + (data.size() - unsentBytes + dataSize));
-            packages.push_back(*pkg); // Add the package to the vector
-        return packages;
+            size_t dataSize = std::min<size_t>(size - sentBytes, max_data_size); // Max data size per package (1440 bytes by default)
+            pkg->data.assign(data + sentBytes, dataSize);
+            sentBytes += dataSize;
+        }
+        return count;
     }
 
 
 // Same as data packages, but the first packag
 std::vector<SlowPackage> fragmentedRevivePackages(std::array<std::byte, 16> sid, uint32_t sttl, uint32_t seqnum, 
-    uint32_t acknum, uint16_t window, uint8_t fid, std::vector<std::byte> data) {
-        auto pkgs = fragmentedDataPackages(sid, sttl, seqnum, acknum, window, fid, data);
+    uint32_t acknum, uint16_t window, uint8_t fid, std::vector<std::byte> data, uint32_t max_data_size) {
+        auto pkgs = fragmentedDataPackages(sid, sttl, seqnum, acknum, window, fid, data, max_data_size);
         // Modify the first package to be a revive package
         if (!pkgs.empty()) {
             pkgs[0].flag_revive = true;
@@ -0,0 +1,98 @@
+#include "package_payload.hpp"
+
+#include <algorithm>
+
+PackagePayload::PackagePayload() : length(0), allocated(INLINE_CAPACITY) {
+}
+
+PackagePayload::PackagePayload(const std::vector<std::byte>& bytes) : PackagePayload() {
+    assign(bytes.data(), bytes.size());
+}
+
+PackagePayload::PackagePayload(const PackagePayload& other) : PackagePayload() {
+    assign(other.data(), other.size());
+}
+
+PackagePayload::PackagePayload(PackagePayload&& other) noexcept : PackagePayload() {
+    *this = std::move(other);
+}
+
+PackagePayload::~PackagePayload() {
+    release();
+}
+
+PackagePayload& PackagePayload::operator=(const PackagePayload& other) {
+    if (this != &other) {
+        assign(other.data(), other.size());
+    }
+    return *this;
+}
+
+PackagePayload& PackagePayload::operator=(PackagePayload&& other) noexcept {
+    if (this == &other) {
+        return *this;
+    }
+
+    if (other.is_inline()) {
+        // inline data is cheap to copy, keeps our own heap buffer (if any) for reuse
+        assign(other.inline_bytes, other.length);
+    } else {
+        // steals the heap buffer
+        release();
+        heap_bytes = other.heap_bytes;
+        allocated = other.allocated;
+        length = other.length;
+
+        other.allocated = INLINE_CAPACITY;
+    }
+    other.length = 0;
+    return *this;
+}
+
+void PackagePayload::release() {
+    if (!is_inline()) {
+        delete[] heap_bytes;
+        allocated = INLINE_CAPACITY;
+    }
+    length = 0;
+}
+
+void PackagePayload::reserve(size_t new_capacity) {
+    if (new_capacity <= allocated) {
+        return;
+    }
+
+    // grows geometrically, like std::vector
+    size_t target = std::max<size_t>(new_capacity, static_cast<size_t>(allocated) * 2);
+    std::byte* fresh = new std::byte[target];
+    std::memcpy(fresh, data(), length);
+
+    uint32_t keep_length = length;
+    release();
+    heap_bytes = fresh;
+    allocated = static_cast<uint32_t>(target);
+    length = keep_length;
+}
+
+void PackagePayload::resize(size_t new_size) {
+    reserve(new_size);
+    if (new_size > length) {
+        std::memset(data() + length, 0, new_size - length);
+    }
+    length = static_cast<uint32_t>(new_size);
+}
+
+void PackagePayload::push_back(std::byte b) {
+    reserve(length + 1);
+    data()[length++] = b;
+}
+
+void PackagePayload::assign(const std::byte* bytes, size_t count) {
+    // never shrinks, so an already grown buffer is reused
+    length = 0;
+    reserve(count);
+    if (count > 0) {
+        std::memmove(data(), bytes, count);
+    }
+    length = static_cast<uint32_t>(count);
+}
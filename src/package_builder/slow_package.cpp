@@ -5,6 +5,7 @@
 #include <iomanip>
 #include <algorithm>    
 #include <cstdint>
+#include <cstring>
 SlowPackage::SlowPackage() {
     // Initialize members with default values if needed
 
@@ -32,16 +33,37 @@ SlowPackage::~SlowPackage() {
      // Clean up resources if necessary    
 }
 
-std::vector<std::byte> SlowPackage::serialize() {
+std::vector<std::byte> SlowPackage::serialize() const {
+    std::vector<std::byte> byteArray;
+    serialize(byteArray);
+    return byteArray;
+}
+
+// little endian (least significant byte first)
+static void writeLittleEndian(std::byte* out, uint32_t value, int bytes) {
+    for (int i = 0; i < bytes; ++i) {
+        out[i] = static_cast<std::byte>((value >> (8 * i)) & 0xFF);
+    }
+}
+
+static uint32_t readLittleEndian(const std::byte* in, int bytes) {
+    uint32_t value = 0;
+    for (int i = 0; i < bytes; ++i) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+void SlowPackage::serialize(std::vector<std::byte>& out) const {
     // Convert the SlowPackage object into a byte array
+    out.resize(32 + data.size());
+    std::byte* byteArray = out.data();
 
     // session UUID (0-127)
-    std::vector<std::byte> byteArray(32);
-    std::copy(sid.begin(), sid.end(), byteArray.begin());
-    
+    std::copy(sid.begin(), sid.end(), byteArray);
+
     // Session TTL (128 - 154)
     // flag bits (155 - 160), 
-    std::vector<std::byte> ttlFlagBytes;
     uint32_t sttlAndFlags = (sttl & 0x07FFFFFF) << 5; // 27 bits for sttl
     if (flag_connect) {
         sttlAndFlags |= (1u << 4); // Set bit 27 for flag_connect
@@ -58,87 +80,64 @@ std::vector<std::byte> SlowPackage::serialize() {
     if (flag_mb) {
         sttlAndFlags |= (1u << 0); // Set bit 31 for flag_mb
     }
-    // Write as little endian (least significant byte first)
-    for (int i = 0; i < 4; ++i) {
-        ttlFlagBytes.push_back(static_cast<std::byte>((sttlAndFlags >> (8 * i)) & 0xFF));
-    }
-    std::copy(ttlFlagBytes.begin(), ttlFlagBytes.end(), byteArray.begin() + 16); // 16 offset
+    writeLittleEndian(byteArray + 16, sttlAndFlags, 4); // 16 offset
 
     // seqnum (161 - 192)
-    std::vector<std::byte> seqnumBytes;
-    for (int i = 0; i < 4; ++i) {
-        seqnumBytes.push_back(static_cast<std::byte>((seqnum >> (8 * i)) & 0xFF));
-    }
-    std::copy(seqnumBytes.begin(), seqnumBytes.end(), byteArray.begin() + 20); // 20 offset
+    writeLittleEndian(byteArray + 20, seqnum, 4); // 20 offset
     // acknum (193 - 224)
-    std::vector<std::byte> acknumBytes;
-    for (int i = 0; i < 4; ++i) {
-        acknumBytes.push_back(static_cast<std::byte>((acknum >> (8 * i)) & 0xFF));
-    }
-    std::copy(acknumBytes.begin(), acknumBytes.end(), byteArray.begin() + 24); // 24 offset
+    writeLittleEndian(byteArray + 24, acknum, 4); // 24 offset
     // window (225 - 240)
-    std::vector<std::byte> windowBytes;
-    for (int i = 0; i < 2; ++i) {
-        windowBytes.push_back(static_cast<std::byte>((window >> (8 * i)) & 0xFF));
-    }
-    std::copy(windowBytes.begin(), windowBytes.end(), byteArray.begin() + 28); // 28 offset
+    writeLittleEndian(byteArray + 28, window, 2); // 28 offset
     // fid (241 - 248)
     byteArray[30] = static_cast<std::byte>(fid); // 30 offset
     // fo (249 - 256)
     byteArray[31] = static_cast<std::byte>(fo); // 31 offset
     // data (257 - end)
     if (!data.empty()) {
-        byteArray.insert(byteArray.end(), data.begin(), data.end());
+        std::memcpy(byteArray + 32, data.data(), data.size());
     }
-    return byteArray;
 }
+
 SlowPackage* SlowPackage::deserialize(std::vector<std::byte> data) {
+    SlowPackage* pkg = new SlowPackage();
+    if (!deserialize(data.data(), data.size(), *pkg)) {
+        delete pkg;
+        return nullptr;
+    }
+    return pkg;
+}
+
+bool SlowPackage::deserialize(const std::byte* bytes, size_t size, SlowPackage& out) {
     // Convert the byte array or string back into a SlowPackage object
-    if (data.size() < 32) {
+    if (size < 32) {
         std::cerr << "Data too short to deserialize into SlowPackage." << std::endl;
-        return nullptr; // Not enough data to deserialize
+        return false; // Not enough data to deserialize
     }
-    SlowPackage* pkg = new SlowPackage();
     // session UUID (0-127)
-    std::copy(data.begin(), data.begin() + 16, pkg->sid.begin());
+    std::copy(bytes, bytes + 16, out.sid.begin());
     // Session TTL and flags (128 - 160)
-    uint32_t sttlAndFlags = 0;
-    for (int i = 0; i < 4; ++i) {
-        sttlAndFlags |= (static_cast<uint32_t>(data[16 + i]) << (8 * i));
-    }
-    pkg->flag_connect = (sttlAndFlags & (1u << 4)) != 0;
-    pkg->flag_revive = (sttlAndFlags & (1u << 3)) != 0;
-    pkg->flag_ack = (sttlAndFlags & (1u << 2)) != 0;
-    pkg->flag_accept_reject = (sttlAndFlags & (1u << 1)) != 0;
-    pkg->flag_mb = (sttlAndFlags & (1u << 0)) != 0;
-    pkg->sttl = (sttlAndFlags >> 5) & 0x07FFFFFF; // Extract sttl (27 bits)
+    uint32_t sttlAndFlags = readLittleEndian(bytes + 16, 4);
+    out.flag_connect = (sttlAndFlags & (1u << 4)) != 0;
+    out.flag_revive = (sttlAndFlags & (1u << 3)) != 0;
+    out.flag_ack = (sttlAndFlags & (1u << 2)) != 0;
+    out.flag_accept_reject = (sttlAndFlags & (1u << 1)) != 0;
+    out.flag_mb = (sttlAndFlags & (1u << 0)) != 0;
+    out.sttl = (sttlAndFlags >> 5) & 0x07FFFFFF; // Extract sttl (27 bits)
     // seqnum (161 - 192)
-    pkg->seqnum = 0;
-    for (int i = 0; i < 4; ++i) {
-        pkg->seqnum |= (static_cast<uint32_t>(data[20 + i]) << (8 * i));
-    }
+    out.seqnum = readLittleEndian(bytes + 20, 4);
     // acknum (193 - 224)
-    pkg->acknum = 0;    
-    for (int i = 0; i < 4; ++i) {
-        pkg->acknum |= (static_cast<uint32_t>(data[24 + i]) << (8 * i));
-    }
+    out.acknum = readLittleEndian(bytes + 24, 4);
     // window (225 - 240)
-    pkg->window = 0;
-    for (int i = 0; i < 2; ++i) {
-        pkg->window |= (static_cast<uint16_t>(data[28 + i]) << (8 * i));
-    }
+    out.window = static_cast<uint16_t>(readLittleEndian(bytes + 28, 2));
     // fid (241 - 248)
-    pkg->fid = static_cast<uint8_t>(data[30]);
+    out.fid = static_cast<uint8_t>(bytes[30]);
     // fo (249 - 256)
-    pkg->fo = static_cast<uint8_t>(data[31]);
-    // data (257 - end)
-    pkg->data.clear();
-    if (data.size() > 32) {
-        pkg->data.insert(pkg->data.end(), data.begin() + 32, data.end());
-    }
-    pkg->findPackageType();
-    
-    return pkg;
+    out.fo = static_cast<uint8_t>(bytes[31]);
+    // data (257 - end), reusing the payload buffer
+    out.data.assign(bytes + 32, size - 32);
+    out.findPackageType();
+
+    return true;
 }
 
 SlowPackage::PackageType SlowPackage::findPackageType() {
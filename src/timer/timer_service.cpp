@@ -0,0 +1,52 @@
+#include "timer_service.hpp"
+
+TimerService& TimerService::shared() {
+    static TimerService* service = new TimerService();
+    return *service;
+}
+
+TimerService::TimerService() : driver(&TimerService::run, this) {}
+
+TimerService::~TimerService() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_one();
+    driver.join();
+}
+
+TimerService::TimerId TimerService::arm_after(std::chrono::microseconds delay, Callback callback) {
+    auto expiry = clock::now() + delay;
+    std::lock_guard<std::mutex> lock(mtx);
+    auto id = wheel.arm(expiry, std::move(callback));
+    if (expiry < wake_at) {
+        // the driver sleeps past this one: it wakes up and sleeps again until the new earliest expiry
+        wake_at = expiry;
+        cv.notify_one();
+    }
+    return id;
+}
+
+bool TimerService::cancel(TimerId id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return wheel.cancel(id);
+}
+
+bool TimerService::armed(TimerId id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    return wheel.armed(id);
+}
+
+void TimerService::run() {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!stopping) {
+        wheel.advance(clock::now());
+        wake_at = wheel.next_expiry();
+        if (wake_at == clock::time_point::max()) {
+            cv.wait(lock);
+        } else {
+            cv.wait_until(lock, wake_at);
+        }
+    }
+}
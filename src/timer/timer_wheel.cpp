@@ -0,0 +1,208 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+
+TimerWheel::TimerWheel(std::chrono::milliseconds tick, clock::time_point start)
+    : tick_duration(std::max<std::chrono::microseconds>(tick, std::chrono::microseconds(1))),
+      start_time(start),
+      current_tick(0),
+      active_timers(0) {
+    for (auto& level : heads) {
+        std::fill(std::begin(level), std::end(level), NONE);
+    }
+    std::fill(std::begin(level_counts), std::end(level_counts), 0);
+}
+
+uint64_t TimerWheel::tick_of(clock::time_point time) const {
+    if (time <= start_time) {
+        return 0;
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - start_time).count() / tick_duration.count();
+}
+
+TimerWheel::TimerId TimerWheel::arm(clock::time_point expiry, Callback callback) {
+    uint32_t index;
+    if (!free_nodes.empty()) {
+        index = free_nodes.back();
+        free_nodes.pop_back();
+    } else {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+
+    auto& node = nodes[index];
+    // rounds up, so a timer never fires early. Timers already due fire on the next tick
+    uint64_t expiry_tick = tick_of(expiry - std::chrono::nanoseconds(1)) + 1;
+    node.expiry_tick = std::max(expiry_tick, current_tick + 1);
+    node.callback = std::move(callback);
+    node.armed = true;
+    link(index);
+    active_timers++;
+
+    return TimerId{index, node.generation};
+}
+
+TimerWheel::TimerId TimerWheel::arm_after(std::chrono::microseconds delay, Callback callback) {
+    return arm(clock::now() + delay, std::move(callback));
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    if (id.generation == 0 || id.index >= nodes.size()) {
+        return false;
+    }
+
+    auto& node = nodes[id.index];
+    if (!node.armed || node.generation != id.generation) {
+        return false;
+    }
+
+    unlink(id.index);
+    node.armed = false;
+    node.generation++;
+    node.callback = nullptr;
+    free_nodes.push_back(id.index);
+    active_timers--;
+    return true;
+}
+
+bool TimerWheel::armed(TimerId id) const {
+    return id.generation != 0 && id.index < nodes.size()
+        && nodes[id.index].armed && nodes[id.index].generation == id.generation;
+}
+
+TimerWheel::clock::time_point TimerWheel::next_expiry() const {
+    if (active_timers == 0) {
+        return clock::time_point::max();
+    }
+
+    // first non empty slot of each level after the current one: a level 0 slot fires on its tick,
+    // a higher level slot cascades on the first tick it covers
+    uint64_t earliest = UINT64_MAX;
+    for (int level = 0; level < LEVELS; level++) {
+        if (level_counts[level] == 0) {
+            continue;
+        }
+        int shift = SLOT_BITS * level;
+        uint64_t position = current_tick >> shift;
+        for (uint64_t k = 1; k <= SLOTS; k++) {
+            if (heads[level][(position + k) & (SLOTS - 1)] != NONE) {
+                earliest = std::min(earliest, (position + k) << shift);
+                break;
+            }
+        }
+    }
+    return start_time + tick_duration * static_cast<int64_t>(earliest);
+}
+
+size_t TimerWheel::advance(clock::time_point now) {
+    uint64_t target = tick_of(now);
+    size_t fired = 0;
+
+    while (current_tick < target) {
+        if (active_timers == 0) {
+            current_tick = target; // nothing to expire, jumps straight to now
+            break;
+        }
+
+        // lower levels empty: nothing can fire before the next slot of the first non empty level cascades
+        int lowest = 0;
+        while (level_counts[lowest] == 0) {
+            lowest++;
+        }
+        if (lowest > 0) {
+            uint64_t level_span = uint64_t(1) << (SLOT_BITS * lowest);
+            uint64_t before_boundary = (current_tick | (level_span - 1));
+            current_tick = std::max(current_tick, std::min(before_boundary, target - 1));
+        }
+
+        current_tick++;
+
+        // every 64^level ticks the next slot of that level moves down (highest level first,
+        // so timers cascaded into a lower level slot that is also due move down again)
+        for (int level = LEVELS - 1; level > 0; level--) {
+            uint64_t level_mask = (uint64_t(1) << (SLOT_BITS * level)) - 1;
+            if ((current_tick & level_mask) == 0) {
+                cascade(level, (current_tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+            }
+        }
+
+        // fires the level 0 slot
+        uint32_t slot = current_tick & (SLOTS - 1);
+        while (heads[0][slot] != NONE) {
+            uint32_t index = heads[0][slot];
+            auto& node = nodes[index];
+            unlink(index);
+
+            if (node.expiry_tick > current_tick) {
+                link(index); // parked beyond the wheel range, not due yet
+                continue;
+            }
+
+            Callback callback = std::move(node.callback);
+            node.callback = nullptr;
+            node.armed = false;
+            node.generation++;
+            free_nodes.push_back(index);
+            active_timers--;
+            fired++;
+
+            // may arm or cancel other timers
+            callback();
+        }
+    }
+
+    return fired;
+}
+
+void TimerWheel::link(uint32_t index) {
+    auto& node = nodes[index];
+    uint64_t delta = node.expiry_tick > current_tick ? node.expiry_tick - current_tick : 0;
+
+    int level = 0;
+    while (level < LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+
+    uint64_t slot_tick = node.expiry_tick;
+    if (level == LEVELS - 1 && delta >= (uint64_t(1) << (SLOT_BITS * LEVELS))) {
+        // out of range: parks it in the farthest slot, it is re-inserted when that slot cascades
+        slot_tick = current_tick + (uint64_t(1) << (SLOT_BITS * LEVELS)) - 1;
+    }
+
+    node.level = static_cast<uint16_t>(level);
+    node.slot = static_cast<uint16_t>((slot_tick >> (SLOT_BITS * level)) & (SLOTS - 1));
+    node.prev = NONE;
+    node.next = heads[level][node.slot];
+    if (node.next != NONE) {
+        nodes[node.next].prev = index;
+    }
+    heads[level][node.slot] = index;
+    level_counts[level]++;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    auto& node = nodes[index];
+    if (node.prev != NONE) {
+        nodes[node.prev].next = node.next;
+    } else {
+        heads[node.level][node.slot] = node.next;
+    }
+    if (node.next != NONE) {
+        nodes[node.next].prev = node.prev;
+    }
+    node.prev = NONE;
+    node.next = NONE;
+    level_counts[node.level]--;
+}
+
+void TimerWheel::cascade(int level, uint32_t slot) {
+    uint32_t index = heads[level][slot];
+    heads[level][slot] = NONE;
+
+    while (index != NONE) {
+        level_counts[level]--;
+        uint32_t next = nodes[index].next;
+        link(index);
+        index = next;
+    }
+}
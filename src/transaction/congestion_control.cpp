@@ -0,0 +1,72 @@
+#include "congestion_control.hpp"
+
+#include <algorithm>
+
+// RTO bounds (same order of magnitude as the N_RETRIES * AWAIT_TIME_MS budget used by Transaction)
+#define INITIAL_RTO_MS 1000
+#define MIN_RTO_MS 100
+#define MAX_RTO_MS 8000
+
+CongestionControl::CongestionControl(uint32_t initial_window, uint32_t max_window)
+    : cwnd(std::max<uint32_t>(initial_window, 1)),
+      ssthresh(max_window),
+      max_window(std::max<uint32_t>(max_window, 1)),
+      peer_advertised_window(max_window),
+      has_rtt_sample(false),
+      srtt(0),
+      rttvar(0),
+      retransmission_timeout(std::chrono::milliseconds(INITIAL_RTO_MS)),
+      pacing_enabled(false) {
+}
+
+void CongestionControl::on_ack(std::chrono::microseconds rtt_sample, bool valid_sample) {
+    if (valid_sample) {
+        if (!has_rtt_sample) {
+            srtt = rtt_sample;
+            rttvar = rtt_sample / 2;
+            has_rtt_sample = true;
+        } else {
+            // rttvar = 3/4 rttvar + 1/4 |srtt - sample|, srtt = 7/8 srtt + 1/8 sample
+            auto delta = srtt > rtt_sample ? srtt - rtt_sample : rtt_sample - srtt;
+            rttvar = (rttvar * 3 + delta) / 4;
+            srtt = (srtt * 7 + rtt_sample) / 8;
+        }
+        retransmission_timeout = std::clamp<std::chrono::microseconds>(srtt + rttvar * 4,
+            std::chrono::milliseconds(MIN_RTO_MS), std::chrono::milliseconds(MAX_RTO_MS));
+    }
+
+    if (cwnd < ssthresh) {
+        cwnd += 1; // slow start: doubles every round trip
+    } else {
+        cwnd += 1 / cwnd; // congestion avoidance: +1 package every round trip
+    }
+    cwnd = std::min<double>(cwnd, max_window);
+}
+
+void CongestionControl::on_loss() {
+    ssthresh = std::max<uint32_t>(static_cast<uint32_t>(cwnd / 2), 2);
+    cwnd = ssthresh;
+}
+
+void CongestionControl::on_timeout() {
+    ssthresh = std::max<uint32_t>(static_cast<uint32_t>(cwnd / 2), 2);
+    cwnd = 1;
+    retransmission_timeout = std::min<std::chrono::microseconds>(retransmission_timeout * 2,
+        std::chrono::milliseconds(MAX_RTO_MS));
+}
+
+void CongestionControl::set_peer_window(uint16_t window) {
+    // a zero window still lets one package through, so we keep probing the peer
+    peer_advertised_window = std::max<uint32_t>(window, 1);
+}
+
+uint32_t CongestionControl::send_window() const {
+    return std::max<uint32_t>(std::min<uint32_t>(static_cast<uint32_t>(cwnd), peer_advertised_window), 1);
+}
+
+std::chrono::microseconds CongestionControl::pacing_interval() const {
+    if (!pacing_enabled || !has_rtt_sample) {
+        return std::chrono::microseconds(0);
+    }
+    return srtt / send_window();
+}
@@ -0,0 +1,117 @@
+#include "message_scheduler.hpp"
+
+#include <algorithm>
+
+#define LOWER_CLASS_WINDOW_SHARE 8 // a class below one in use gets 1/8 of the window
+#define CLASS_HOLD_MS 1000 // a class counts as in use this long after its last fragment
+
+void MessageScheduler::add(uint32_t id, MessagePriority priority, uint32_t weight, size_t fragments) {
+    weight = std::max<uint32_t>(weight, 1);
+    this->entries.push_back(Entry{id, priority, weight, fragments, weight, false, 0});
+}
+
+void MessageScheduler::remove(uint32_t id) {
+    for (size_t i = 0; i < this->entries.size(); i++) {
+        if (this->entries[i].id != id) {
+            continue;
+        }
+
+        this->class_in_flight[static_cast<size_t>(this->entries[i].priority)] -= this->entries[i].in_flight;
+        this->entries.erase(this->entries.begin() + i);
+        if (i < this->cursor) {
+            this->cursor--; // keeps pointing at the same message
+        }
+        if (this->cursor >= this->entries.size()) {
+            this->cursor = 0;
+        }
+        return;
+    }
+}
+
+void MessageScheduler::hold(uint32_t id, bool held) {
+    auto entry = this->find(id);
+    if (entry != nullptr) {
+        entry->held = held;
+    }
+}
+
+uint32_t MessageScheduler::class_limit(MessagePriority priority, uint32_t window, std::chrono::steady_clock::time_point now) const {
+    bool higher_in_use = false;
+    for (size_t c = static_cast<size_t>(priority) + 1; c < CLASSES; c++) {
+        higher_in_use |= now - this->class_last_sent[c] < std::chrono::milliseconds(CLASS_HOLD_MS);
+    }
+    for (const auto& entry : this->entries) {
+        higher_in_use |= entry.priority > priority;
+    }
+    return higher_in_use ? std::max<uint32_t>(window / LOWER_CLASS_WINDOW_SHARE, 1) : window;
+}
+
+bool MessageScheduler::next(uint32_t* id, uint32_t window, std::chrono::steady_clock::time_point now) {
+    // highest class with something to send
+    bool found = false;
+    MessagePriority top = MessagePriority::BULK;
+    for (const auto& entry : this->entries) {
+        if (can_send(entry) && (!found || entry.priority > top)) {
+            top = entry.priority;
+            found = true;
+        }
+    }
+    if (!found || this->class_in_flight[static_cast<size_t>(top)] >= this->class_limit(top, window, now)) {
+        return false;
+    }
+
+    // two passes at most: if every message of the class used its quantum, a new round starts
+    for (int round = 0; round < 2; round++) {
+        for (size_t k = 0; k < this->entries.size(); k++) {
+            size_t i = (this->cursor + k) % this->entries.size();
+            auto& entry = this->entries[i];
+            if (!can_send(entry) || entry.priority != top || entry.credit == 0) {
+                continue;
+            }
+
+            entry.credit--;
+            entry.remaining--;
+            entry.in_flight++;
+            this->class_in_flight[static_cast<size_t>(top)]++;
+            this->class_last_sent[static_cast<size_t>(top)] = now;
+            // stays on this message until its quantum is used
+            this->cursor = entry.credit > 0 ? i : (i + 1) % this->entries.size();
+            *id = entry.id;
+            return true;
+        }
+
+        for (auto& entry : this->entries) {
+            if (can_send(entry) && entry.priority == top) {
+                entry.credit = entry.weight;
+            }
+        }
+    }
+    return false;
+}
+
+void MessageScheduler::give_back(uint32_t id) {
+    auto entry = this->find(id);
+    if (entry != nullptr) {
+        entry->remaining++;
+        entry->credit++;
+        entry->in_flight--;
+        this->class_in_flight[static_cast<size_t>(entry->priority)]--;
+    }
+}
+
+void MessageScheduler::acked(uint32_t id) {
+    auto entry = this->find(id);
+    if (entry != nullptr && entry->in_flight > 0) {
+        entry->in_flight--;
+        this->class_in_flight[static_cast<size_t>(entry->priority)]--;
+    }
+}
+
+MessageScheduler::Entry* MessageScheduler::find(uint32_t id) {
+    for (auto& entry : this->entries) {
+        if (entry.id == id) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,15 @@
+#include "operation_status.hpp"
+
+std::string operationStatusToString(OperationStatus status) {
+    switch (status) {
+        case OperationStatus::OK: return "OK";
+        case OperationStatus::TIMEOUT: return "TIMEOUT";
+        case OperationStatus::REJECTED: return "REJECTED";
+        case OperationStatus::EXPIRED: return "EXPIRED";
+        case OperationStatus::CANCELLED: return "CANCELLED";
+        case OperationStatus::NOT_CONNECTED: return "NOT_CONNECTED";
+        case OperationStatus::SEND_FAILED: return "SEND_FAILED";
+        case OperationStatus::TOO_LARGE: return "TOO_LARGE";
+    }
+    return "UNKNOWN";
+}
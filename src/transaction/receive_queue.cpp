@@ -0,0 +1,152 @@
+#include "receive_queue.hpp"
+
+void ReceiveQueue::set_session(const std::array<std::byte, 16>& sid) {
+    this->session = sid;
+    this->has_session = true;
+}
+
+void ReceiveQueue::clear_session() {
+    this->has_session = false;
+}
+
+void ReceiveQueue::expect_acks(uint32_t first, size_t count) {
+    this->ack_first = first;
+    this->ack_states.assign(count, AWAITED);
+    if (this->ack_packages.size() < count) {
+        this->ack_packages.resize(count);
+    }
+    this->pending_acks = 0;
+    this->has_latest_ack = false;
+    this->latest_ack_unread = false;
+}
+
+void ReceiveQueue::expect_more_acks(size_t count) {
+    // drops the taken states at the front once they are half the window, so a long run of
+    // messages keeps the vector at the size of what is in flight (erase does not allocate)
+    size_t taken = 0;
+    while (taken < this->ack_states.size() && this->ack_states[taken] == TAKEN) {
+        taken++;
+    }
+    if (taken > 0 && taken * 2 >= this->ack_states.size()) {
+        this->ack_states.erase(this->ack_states.begin(), this->ack_states.begin() + taken);
+        // the packages move with their states (swaps, so their buffers are kept)
+        for (size_t i = taken; i < taken + this->ack_states.size(); i++) {
+            std::swap(this->ack_packages[i - taken], this->ack_packages[i]);
+        }
+        this->ack_first += static_cast<uint32_t>(taken);
+    }
+
+    this->ack_states.insert(this->ack_states.end(), count, AWAITED);
+    if (this->ack_packages.size() < this->ack_states.size()) {
+        this->ack_packages.resize(this->ack_states.size());
+    }
+}
+
+void ReceiveQueue::forget_ack(uint32_t seqnum) {
+    uint32_t offset = seqnum - this->ack_first;
+    if (offset >= this->ack_states.size()) {
+        return;
+    }
+
+    if (this->ack_states[offset] == ARRIVED) {
+        this->pending_acks--;
+    }
+    this->ack_states[offset] = TAKEN;
+}
+
+void ReceiveQueue::clear_acks() {
+    this->ack_states.clear();
+    this->pending_acks = 0;
+    this->has_latest_ack = false;
+    this->latest_ack_unread = false;
+}
+
+void ReceiveQueue::expect_response(SlowPackage::PackageType type, uint32_t acknum) {
+    this->response_expected = true;
+    this->response_type = type;
+    this->response_acknum = acknum;
+    this->has_response = false;
+}
+
+void ReceiveQueue::clear_response() {
+    this->response_expected = false;
+    this->has_response = false;
+}
+
+bool ReceiveQueue::offer(const SlowPackage& package) {
+    if (this->has_session && package.sid != this->session) {
+        this->counters.stale++;
+        return false;
+    }
+
+    // the response of the exchange in progress. A second copy (e.g. the SETUP of a retransmitted CONNECT) is dropped
+    if (this->response_expected && package.type == this->response_type && package.acknum == this->response_acknum) {
+        if (this->has_response) {
+            this->counters.duplicates++;
+            return false;
+        }
+        this->response = package;
+        this->has_response = true;
+        this->counters.accepted++;
+        return true;
+    }
+
+    // acks of the fragments in flight (unsigned offset, so seqnums before the window are out of it too)
+    uint32_t offset = package.acknum - this->ack_first;
+    if (package.type == SlowPackage::ACK && offset < this->ack_states.size()) {
+        auto& state = this->ack_states[offset];
+        if (state != AWAITED) {
+            this->counters.duplicates++;
+            return false;
+        }
+        state = ARRIVED;
+        this->ack_packages[offset] = package; // acks carry no data: copying reuses the slot buffers
+        this->pending_acks++;
+
+        // the newest ack (highest acknum) carries the freshest window. An unread one it replaces is merged into it
+        if (!this->has_latest_ack || !seqnum_after(this->latest_ack.acknum, package.acknum)) {
+            if (this->latest_ack_unread) {
+                this->counters.coalesced++;
+            }
+            this->latest_ack = package;
+            this->has_latest_ack = true;
+            this->latest_ack_unread = true;
+        }
+        this->counters.accepted++;
+        return true;
+    }
+
+    this->counters.stale++;
+    return false;
+}
+
+bool ReceiveQueue::take(SlowPackage::PackageType type, uint32_t acknum, SlowPackage* package) {
+    if (this->has_response && type == this->response_type && acknum == this->response_acknum) {
+        *package = std::move(this->response);
+        this->has_response = false;
+        return true;
+    }
+
+    uint32_t offset = acknum - this->ack_first;
+    if (type == SlowPackage::ACK && offset < this->ack_states.size() && this->ack_states[offset] == ARRIVED) {
+        this->ack_states[offset] = TAKEN;
+        this->pending_acks--;
+        *package = this->ack_packages[offset];
+        return true;
+    }
+
+    return false;
+}
+
+bool ReceiveQueue::take_latest_ack(SlowPackage* package) {
+    if (!this->latest_ack_unread) {
+        return false;
+    }
+    this->latest_ack_unread = false;
+    *package = this->latest_ack;
+    return true;
+}
+
+size_t ReceiveQueue::pending() const {
+    return this->pending_acks + (this->has_response ? 1 : 0);
+}
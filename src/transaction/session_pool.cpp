@@ -0,0 +1,285 @@
+#include "session_pool.hpp"
+#include "logger.hpp"
+
+#include <algorithm>
+
+#define REPAIR_TIMEOUT_MS 2000 // budget of a background revive/replace round
+#define CLOSE_TIMEOUT_MS 2000 // budget to disconnect the idle sessions when the pool is destroyed
+
+SessionPool::SessionPool(const std::string& host, int port, size_t size, UdpBackend backend,
+        std::chrono::milliseconds maintenance_interval)
+    : SessionPool(std::make_shared<EndpointSet>(std::vector<Endpoint>{Endpoint{host, port}}), size, backend, maintenance_interval) {
+}
+
+SessionPool::SessionPool(std::shared_ptr<EndpointSet> endpoints, size_t size, UdpBackend backend,
+        std::chrono::milliseconds maintenance_interval)
+    : endpoints(std::move(endpoints)), size(std::max<size_t>(size, 1)), backend(backend), maintenance_interval(maintenance_interval) {
+}
+
+SessionPool::~SessionPool() {
+    this->close(deadlineIn(std::chrono::milliseconds(CLOSE_TIMEOUT_MS)));
+}
+
+SessionPool::Session* SessionPool::create_session() {
+    auto session = std::make_unique<Session>();
+    session->client = std::make_unique<UdpClient>(this->endpoints, this->backend);
+    session->client->setupConnection();
+    session->transaction = std::make_unique<Transaction>(session->client.get());
+
+    this->sessions.push_back(std::move(session));
+    return this->sessions.back().get();
+}
+
+bool SessionPool::ready(Session* session) {
+    return session->transaction->connection_status == ConnectionStatus::CONNECTED
+        && session->transaction->connection_still_alive();
+}
+
+size_t SessionPool::connect_all(const std::vector<Session*>& pending, Deadline deadline, const CancellationToken* token) {
+    // every CONNECT goes out before waiting for any SETUP, so all the round trips overlap
+    std::vector<Session*> sent;
+    for (auto session : pending) {
+        if (session->transaction->begin_connect() == OperationStatus::OK) {
+            sent.push_back(session);
+        }
+    }
+
+    size_t connected = 0;
+    for (auto session : sent) {
+        if (session->transaction->finish_connect(deadline, token) == OperationStatus::OK) {
+            connected++;
+        }
+    }
+    return connected;
+}
+
+size_t SessionPool::warm_up(Deadline deadline, const CancellationToken* token) {
+    std::vector<Session*> pending;
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        while (this->sessions.size() < this->size) {
+            pending.push_back(this->create_session());
+        }
+    }
+
+    Log(LogLevel::INFO, "[session pool] connecting " + std::to_string(pending.size()) + " sessions");
+    size_t connected = this->connect_all(pending, deadline, token);
+
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        this->idle.insert(this->idle.end(), pending.begin(), pending.end());
+        this->counters.failures += pending.size() - connected;
+
+        if (!this->maintenance_thread.joinable()) {
+            this->stopping = false;
+            this->maintenance_thread = std::thread(&SessionPool::maintenance_loop, this);
+        }
+    }
+
+    Log(LogLevel::INFO, "[session pool] " + std::to_string(connected) + " of " + std::to_string(pending.size()) + " sessions ready");
+    return connected;
+}
+
+bool SessionPool::take_idle(Session* session) {
+    auto it = std::find(this->idle.begin(), this->idle.end(), session);
+    if (it == this->idle.end()) {
+        return false;
+    }
+    this->idle.erase(it);
+    return true;
+}
+
+Transaction* SessionPool::lease(Deadline deadline, const CancellationToken* token) {
+    // readiness is checked without the lock (an expired session logs), on the idle sessions of the moment,
+    // most recently released first
+    std::vector<Session*> candidates;
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        candidates.assign(this->idle.rbegin(), this->idle.rend());
+    }
+    for (auto candidate : candidates) {
+        if (!ready(candidate)) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(this->mtx);
+        if (this->take_idle(candidate)) {
+            this->counters.hits++;
+            this->counters.leased++;
+            return candidate->transaction.get();
+        }
+    }
+
+    Session* session = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        // miss: reconnects an idle session seen not ready, or opens one more session
+        this->counters.misses++;
+        for (auto candidate : candidates) {
+            if (this->take_idle(candidate)) {
+                session = candidate;
+                break;
+            }
+        }
+        if (session == nullptr) {
+            session = this->create_session();
+        }
+    }
+
+    auto status = session->transaction->connect(deadline, token);
+
+    std::lock_guard<std::mutex> lock(this->mtx);
+    if (status != OperationStatus::OK) {
+        Log(LogLevel::ERROR, "[session pool] could not connect a session to lease: " + operationStatusToString(status));
+        this->counters.failures++;
+        this->idle.push_back(session); // the maintenance thread tries again later
+        return nullptr;
+    }
+
+    this->counters.leased++;
+    return session->transaction.get();
+}
+
+void SessionPool::release(Transaction* transaction) {
+    std::unique_ptr<Session> extra;
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        auto it = std::find_if(this->sessions.begin(), this->sessions.end(),
+            [transaction](const std::unique_ptr<Session>& session) { return session->transaction.get() == transaction; });
+        if (it == this->sessions.end()) {
+            Log(LogLevel::ERROR, "[session pool] released a transaction that does not belong to the pool");
+            return;
+        }
+        this->counters.leased--;
+
+        // counts every session owned: the maintenance thread may hold some idle ones out of the idle list
+        if (this->sessions.size() <= this->size) {
+            this->idle.push_back(it->get());
+            return;
+        }
+
+        // opened on a miss while the pool was exhausted: not kept
+        extra = std::move(*it);
+        this->sessions.erase(it);
+    }
+
+    if (extra->transaction->connection_status == ConnectionStatus::CONNECTED) {
+        extra->transaction->disconnect(deadlineIn(std::chrono::milliseconds(REPAIR_TIMEOUT_MS)));
+    }
+}
+
+void SessionPool::close(Deadline deadline) {
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        this->stopping = true;
+    }
+    this->maintenance_cv.notify_all();
+    if (this->maintenance_thread.joinable()) {
+        this->maintenance_thread.join();
+    }
+
+    std::vector<Session*> to_close;
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        to_close = this->idle;
+    }
+
+    for (auto session : to_close) {
+        if (session->transaction->connection_status == ConnectionStatus::CONNECTED) {
+            session->transaction->disconnect(deadline);
+        }
+    }
+}
+
+SessionPoolStats SessionPool::stats() const {
+    std::lock_guard<std::mutex> lock(this->mtx);
+    SessionPoolStats stats = this->counters;
+    stats.idle = this->idle.size();
+    return stats;
+}
+
+void SessionPool::maintain() {
+    // checks the idle sessions without the lock (an expired session logs), then takes the ones that need
+    // work out of the pool while working on them, unless they were leased in the meantime
+    std::vector<Session*> candidates;
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        candidates = this->idle;
+    }
+
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), ready), candidates.end());
+    if (candidates.empty()) {
+        return;
+    }
+
+    std::vector<Session*> taken;
+    {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        for (auto session : candidates) {
+            if (this->take_idle(session)) {
+                taken.push_back(session);
+            }
+        }
+    }
+
+    // looked at again now that nobody else can lease them: one may have been leased and released meanwhile
+    std::vector<Session*> to_revive;
+    std::vector<Session*> to_replace;
+    std::vector<Session*> healthy;
+    for (auto session : taken) {
+        auto transaction = session->transaction.get();
+        bool alive = transaction->connection_still_alive();
+        if (transaction->connection_status == ConnectionStatus::CONNECTED && alive) {
+            healthy.push_back(session);
+        } else if (alive) {
+            to_revive.push_back(session); // disconnected by its last caller, but the server still keeps the session
+        } else {
+            to_replace.push_back(session);
+        }
+    }
+    if (!healthy.empty()) {
+        std::lock_guard<std::mutex> lock(this->mtx);
+        this->idle.insert(this->idle.end(), healthy.begin(), healthy.end());
+    }
+
+    if (to_revive.empty() && to_replace.empty()) {
+        return;
+    }
+
+    auto deadline = deadlineIn(std::chrono::milliseconds(REPAIR_TIMEOUT_MS));
+    size_t revived = 0;
+    for (auto session : to_revive) {
+        // an empty DATA package with the revive flag
+        if (session->transaction->send_data("", true, deadline) == OperationStatus::OK) {
+            revived++;
+        } else {
+            to_replace.push_back(session); // e.g. expired in the meantime
+        }
+    }
+
+    size_t replaced = this->connect_all(to_replace, deadline, nullptr);
+
+    std::lock_guard<std::mutex> lock(this->mtx);
+    this->idle.insert(this->idle.end(), to_revive.begin(), to_revive.end());
+    for (auto session : to_replace) {
+        if (std::find(to_revive.begin(), to_revive.end(), session) == to_revive.end()) {
+            this->idle.push_back(session);
+        }
+    }
+    this->counters.revived += revived;
+    this->counters.replaced += replaced;
+    this->counters.failures += to_replace.size() - replaced;
+}
+
+void SessionPool::maintenance_loop() {
+    std::unique_lock<std::mutex> lock(this->mtx);
+    while (!this->stopping) {
+        this->maintenance_cv.wait_for(lock, this->maintenance_interval, [this] { return this->stopping; });
+        if (this->stopping) {
+            break;
+        }
+
+        lock.unlock();
+        this->maintain();
+        lock.lock();
+    }
+}
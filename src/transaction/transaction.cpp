@@ -4,9 +4,19 @@
 #include "udp_client.hpp"
 #include "package_builder.hpp"
 #include<string>
+#include <algorithm>
+#include <sys/eventfd.h>
+#include <unistd.h>
 
 #define N_RETRIES 10
 #define AWAIT_TIME_MS 100
+#define CANCEL_CHECK_MS 10 // longest an operation waits without checking its cancellation token
+#define MAX_CONSECUTIVE_TIMEOUTS 4 // retransmission timeouts in a row (without any ack) before giving up
+#define REORDER_THRESHOLD 3 // later fragments acked before a fragment is considered lost
+#define MAX_EXCHANGE_ATTEMPTS 3 // transmissions of a connect/disconnect package when there is no deadline
+#define FAILOVER_TIMEOUT_MS 300 // wait for a SETUP from a never measured endpoint when another endpoint can take over
+#define LISTENER_WAIT_MS 100 // longest the listener blocks without a datagram (stop_listener wakes it sooner)
+#define MAX_MESSAGES 256 // messages in flight at once: one per fid
 
 Transaction::Transaction(UdpClient *client) {
     if  (client == nullptr) {
@@ -15,6 +25,8 @@ Transaction::Transaction(UdpClient *client) {
     }
 
     this->client = client;
+    this->listener_wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    this->message_slots.reserve(MAX_MESSAGES);
 
     this->connection_status_mtx.lock();
     this->connection_status = ConnectionStatus::OFFLINE;
@@ -22,209 +34,756 @@ Transaction::Transaction(UdpClient *client) {
 }
 
 Transaction::~Transaction() {
+    this->stop_listener();
+    this->timers.cancel(this->session_expiration); // its callback points to this session
     this->client = nullptr;
-
-    
+    if (this->listener_wake_fd >= 0) {
+        close(this->listener_wake_fd);
+    }
 }
 
-bool Transaction::connection_still_alive() {
-    if (std::chrono::steady_clock::now() < this->session_expiration) {
+bool Transaction::connection_still_alive() const {
+    if (!this->session_expired) {
         return true;
     }
 
     Log(LogLevel::WARNING, "[transaction] SESSION EXPIRED");
-
-    this->connection_status_mtx.lock();
     // this->connection_status = ConnectionStatus::EXPIRED; // TODO : FIX
-    this->connection_status_mtx.unlock();
-
     return false;
 }
 
-bool Transaction::connect() {
-    Log(LogLevel::INFO, "[transaction] requesting connection");
+void Transaction::wake_consumer() {
+    {
+        std::lock_guard<std::mutex> lock(this->wake_mtx);
+        this->wakeups++;
+    }
+    this->wake_cv.notify_one();
+}
 
-    this->connection_status = ConnectionStatus::CONNECTING; 
-    // spawns the listener thread
-    this->listener_thread = std::thread(&Transaction::listen_to_incoming_data, this);
+void Transaction::post_expiry(uint64_t key) {
+    {
+        std::lock_guard<std::mutex> lock(this->wake_mtx);
+        this->posted_expiries.push_back(key);
+        this->wakeups++;
+    }
+    this->wake_cv.notify_one();
+}
 
-    // Builds connection package
-    auto connect_package = connectPackage(256);
+void Transaction::wait_for_events(std::chrono::steady_clock::time_point until) {
+    until = std::min(until, std::chrono::steady_clock::now() + std::chrono::milliseconds(CANCEL_CHECK_MS));
+    std::unique_lock<std::mutex> lock(this->wake_mtx);
+    this->wake_cv.wait_until(lock, until, [this] { return this->wakeups != this->wakeups_seen; });
+    this->wakeups_seen = this->wakeups;
+}
 
-    // serializing
-    auto data_bytes = connect_package.serialize();
+void Transaction::arm_session_expiration(uint32_t sttl) {
+    const uint32_t MAX_27BIT = 0x7FFFFFF;
 
-    bool sent = false;
-    // tries to send it 5 times
-    for (int i = 0; i < 5; i++) {
-        if (this->client->send_bytes(data_bytes)) {
-            sent = true;
-            break;
-        }
+    // (mask duration to 27 bits)
+    std::chrono::milliseconds ttl_duration(sttl & MAX_27BIT); // converting to milliseconds
+
+    this->timers.cancel(this->session_expiration);
+    this->session_expired = false;
+    this->session_expiration = this->timers.arm_after(ttl_duration, [this] { this->session_expired = true; });
+}
+
+// returns the status that stops a waiting operation, or OK if it can keep waiting
+static OperationStatus check_budget(Deadline deadline, const CancellationToken* token) {
+    if (token != nullptr && token->is_cancelled()) {
+        return OperationStatus::CANCELLED;
+    }
+    if (std::chrono::steady_clock::now() >= deadline) {
+        return OperationStatus::TIMEOUT;
     }
+    return OperationStatus::OK;
+}
 
-    if (!sent) {
-        Log(LogLevel::ERROR, "[transaction] error sending connect package. Cancelling");
-        return false;
+OperationStatus Transaction::connect(Deadline deadline, const CancellationToken* token) {
+    auto status = this->begin_connect();
+    if (status != OperationStatus::OK) {
+        return status;
     }
+    return this->finish_connect(deadline, token);
+}
 
-    Log(LogLevel::INFO, "[transaction] connect package sent successfully");
+OperationStatus Transaction::begin_connect() {
+    Log(LogLevel::INFO, "[transaction] requesting connection");
 
-    // receive setup data (containing sesstion and stuff)
-    SlowPackage setup_data;
-    bool found = false;
-    int retries = N_RETRIES;
+    this->connection_status = ConnectionStatus::CONNECTING; 
+    // spawns the listener thread
+    this->start_listener();
+
+    // new sessions go to the best endpoint known right now
+    this->client->selectEndpoint();
+    this->receive_queue.clear_session(); // the SETUP brings the new session id
+
+    // Builds connection package, advertising our actual receive capacity
+    this->connect_request = connectPackage(this->receive_window());
+    this->connect_sent_at = std::chrono::steady_clock::now();
+    if (!this->client->send_bytes(this->connect_request.serialize())) {
+        Log(LogLevel::ERROR, "[transaction] error sending connect package");
+        this->stop_listener();
+        return OperationStatus::SEND_FAILED;
+    }
+    this->transmit_counters.packages_sent++;
 
-    while (retries-- > 0) {
-        // if it finds, exit while
-        if(this->check_buffer_for_data(SlowPackage::SETUP, 0, &setup_data)) {
-            found = true;
-            break;
-        }
+    this->connect_pending = true;
+    return OperationStatus::OK;
+}
 
-        // if it doesnt find, sleep for 100 ms and try again for N_RETRIES
-        std::this_thread::sleep_for(std::chrono::milliseconds(AWAIT_TIME_MS));
+OperationStatus Transaction::finish_connect(Deadline deadline, const CancellationToken* token) {
+    if (!this->connect_pending) {
+        Log(LogLevel::ERROR, "[transaction] finish_connect called without begin_connect");
+        return OperationStatus::NOT_CONNECTED;
     }
-    
-    if (!found) {
-        // error
-        Log(LogLevel::ERROR, "[transaction] did not receive any setup msg from server");
-        return false;
+    this->connect_pending = false;
+
+    // receive setup data (containing sesstion and stuff)
+    SlowPackage setup_data;
+    auto status = this->exchange(this->connect_request, SlowPackage::SETUP, 0, &setup_data, deadline, token, this->connect_sent_at);
+    if (status != OperationStatus::OK) {
+        Log(LogLevel::ERROR, "[transaction] did not receive any setup msg from server: " + operationStatusToString(status));
+        this->stop_listener();
+        return status;
     }
 
     // found a setup, but it may be rejected
 
     if (!setup_data.flag_accept_reject) {
         Log(LogLevel::WARNING, "[transaction] connection rejected by server");
-        return false;
+        this->stop_listener();
+        return OperationStatus::REJECTED;
     } 
 
     Log(LogLevel::INFO, "[transaction] received setup response from server. Connection accepted");
     // save session data
     this->session_uuid = setup_data.sid; // TODO: check on how it will be implemented
+    this->receive_queue.set_session(setup_data.sid);
     this->current_seqnum = setup_data.seqnum;
     this->current_sttl = setup_data.sttl;
     // set session expiration
-    const uint32_t MAX_27BIT = 0x7FFFFFF;
-
-    // (mask duration to 27 bits)
-    auto received_sttl = setup_data.sttl & MAX_27BIT;
-    
-    std::chrono::milliseconds ttl_duration(received_sttl); // converting to milliseconds
+    this->arm_session_expiration(setup_data.sttl);
 
-    this->session_expiration = std::chrono::steady_clock::now() + ttl_duration;
+    // server receive window
+    this->cc.set_peer_window(setup_data.window);
     
     this->connection_status_mtx.lock();
     this->connection_status = ConnectionStatus::CONNECTED;
     this->connection_status_mtx.unlock();
 
-    return true;
+    return OperationStatus::OK;
 }
 
-bool Transaction::send_data(std::string data, bool revive, int attempts_left) {
-    Log(LogLevel::INFO, "[transaction] sending data: '" + data + "'. Attempts left: " + std::to_string(attempts_left));
+OperationStatus Transaction::send_data(const std::string& data, bool revive, Deadline deadline, const CancellationToken* token) {
+    return this->send_message(reinterpret_cast<const std::byte*>(data.data()), data.size(), MessageOptions(), revive, deadline, token);
+}
+
+OperationStatus Transaction::send_data(const std::string& data, const MessageOptions& options, Deadline deadline, const CancellationToken* token) {
+    return this->send_message(reinterpret_cast<const std::byte*>(data.data()), data.size(), options, false, deadline, token);
+}
+
+OperationStatus Transaction::send_message(const std::byte* data, size_t size, const MessageOptions& options, bool revive,
+        Deadline deadline, const CancellationToken* token) {
+    if (LogEnabled(LogLevel::INFO)) {
+        Log(LogLevel::INFO, "[transaction] sending " + std::to_string(size) + " bytes of data" + (revive ? " (revive)" : ""));
+    }
 
     if (this->connection_status != ConnectionStatus::CONNECTED && !revive) {
         Log(LogLevel::ERROR, "[transaction] failed to send data: not connected.");
-        return false;
+        return OperationStatus::NOT_CONNECTED;
     }
 
-    // for now, limit the data size to 1440 bytes (1472 - 32 bytes from header)
-    int seqnum = this->current_seqnum;
+    if (revive && !this->connection_still_alive()) {
+        Log(LogLevel::ERROR, "[transaction] connection expired. Cannot send data with revive flag");
+        return OperationStatus::EXPIRED;
+    }
 
-    SlowPackage package_data;
+    if (size > this->max_message_size()) {
+        Log(LogLevel::ERROR, "[transaction] message of " + std::to_string(size) + " bytes needs more than "
+            + std::to_string(MAX_FRAGMENTS) + " fragments of " + std::to_string(this->session_max_payload) + " bytes");
+        return OperationStatus::TOO_LARGE;
+    }
 
-    // Package building
     if (revive) {
-        package_data = fragmentedRevivePackages(session_uuid, current_sttl, seqnum, last_acknum, 256, 0,std::vector<std::byte>(reinterpret_cast<const std::byte*>(data.data()), reinterpret_cast<const std::byte*>(data.data()) + data.size()))[0];
+        Log(LogLevel::INFO, "[transaction] connection still alive. Sending data with revive flag");
+        if (this->connection_status != ConnectionStatus::CONNECTED) {
+            this->connection_status = ConnectionStatus::CONNECTING; // setting status to connecting
+            this->start_listener();
+        }
+    }
+
+    // a slot and a fid of its own. With every fid taken by a message in flight, waits for one to be over
+    std::unique_lock<std::mutex> lock(this->send_mtx);
+    auto fid_free = [this] { return !this->fids_in_use.all(); };
+    if (deadline == NO_DEADLINE) {
+        this->send_cv.wait(lock, fid_free);
+    } else if (!this->send_cv.wait_until(lock, deadline, fid_free)) {
+        Log(LogLevel::ERROR, "[transaction] no fid available before the deadline");
+        return OperationStatus::TIMEOUT;
     }
-    else {
-        package_data = fragmentedDataPackages(session_uuid, current_sttl, seqnum, last_acknum, 256, 0,std::vector<std::byte>(reinterpret_cast<const std::byte*>(data.data()), reinterpret_cast<const std::byte*>(data.data()) + data.size()))[0];
+
+    OutgoingMessage* message;
+    if (this->free_messages.empty()) {
+        this->message_slots.push_back(std::make_unique<OutgoingMessage>());
+        message = this->message_slots.back().get();
+        message->slot = static_cast<uint32_t>(this->message_slots.size() - 1);
+    } else {
+        message = this->free_messages.back();
+        this->free_messages.pop_back();
+    }
+    while (this->fids_in_use.test(this->next_fid)) {
+        this->next_fid++;
+    }
+    message->fid = this->next_fid++;
+    this->fids_in_use.set(message->fid);
+    lock.unlock();
+
+    // Package building, into the fragments of the previous messages of the slot (no allocation once they are big enough).
+    // seqnum, acknum and window are only known when each fragment is first sent
+    message->count = fragmentDataPackagesInto(message->fragments, this->session_uuid, this->current_sttl, 0, 0, 0,
+        message->fid, data, size, this->session_max_payload);
+    message->fragments[0].flag_revive = revive;
+    if (message->serialized.size() < message->count) {
+        message->serialized.resize(message->count);
+    }
+    message->states.assign(message->count, FragmentState());
+    message->options = options;
+    message->revive = revive;
+    message->revive_accepted = false;
+    message->deadline = deadline;
+    message->token = token;
+    message->sent = 0;
+    message->acked = 0;
+    message->first_unacked = 0;
+    message->done = false;
+
+    // the first caller without a sending thread in place sends for every message, until its own is over.
+    // Then one of the callers still waiting takes over
+    lock.lock();
+    this->submitted_messages.push_back(message);
+    if (this->sending) {
+        this->wake_consumer(); // the sending thread picks it up without waiting for an ack
+    }
+    while (!message->done) {
+        if (this->sending) {
+            this->send_cv.wait(lock);
+            continue;
+        }
+        this->sending = true;
+        lock.unlock();
+        this->send_messages(message);
+        lock.lock();
+        this->sending = false;
+        this->send_cv.notify_all();
     }
 
-    if (revive)  {
-        if (!this->connection_still_alive()) {
-            Log(LogLevel::ERROR, "[transaction] connection expired. Cannot send data with revive flag");
-            return false;
+    auto status = message->status;
+    this->fids_in_use.reset(message->fid);
+    this->free_messages.push_back(message);
+    this->send_cv.notify_all();
+    bool revive_accepted = message->revive_accepted;
+    lock.unlock();
+
+    if (status != OperationStatus::OK) {
+        Log(LogLevel::ERROR, "[transaction] data not acknowledged by the server: " + operationStatusToString(status));
+        if (revive && !revive_accepted) {
+            this->stop_listener();
         }
+        return status;
+    }
+
+    Log(LogLevel::INFO, "[transaction] ack received for data. Data successfully sent");
+    return OperationStatus::OK;
+}
 
-        package_data.flag_revive = true;
+void Transaction::adopt_submitted_messages() {
+    std::lock_guard<std::mutex> lock(this->send_mtx);
+    for (auto message : this->submitted_messages) {
+        if (this->active_messages.empty()) {
+            // new run of messages: seqnums go on from the current one
+            this->receive_queue.expect_acks(this->current_seqnum, 0);
+            this->recovery_seqnum = this->current_seqnum;
+            this->consecutive_timeouts = 0;
+        }
 
-        this->connection_status_mtx.lock();
-        this->connection_status = ConnectionStatus::CONNECTING; // setting status to connecting
-        this->connection_status_mtx.unlock();
-        
-        Log(LogLevel::INFO, "[transaction] connection still alive. Sending data with revive flag");
-        this->listener_thread.join(); // wait for the previous listener thread to finish
-        this->listener_thread = std::thread(&Transaction::listen_to_incoming_data, this);
-        Log(LogLevel::INFO, "[transaction] listener thread spawned for revive data");
+        message->scheduled = true;
+        this->active_messages.push_back(message);
+        this->scheduler.add(message->slot, message->options.priority, message->options.weight, message->count);
     }
-    auto package_bytes = package_data.serialize();
-    
-    bool sent = false;
+    this->submitted_messages.clear();
+}
 
-    for (int i = 0; i <5 ; i++ ) {
-        if (this->client->send_bytes(package_bytes)) {
-            sent = true;
-            break;
+void Transaction::finish_message(OutgoingMessage* message, OperationStatus status) {
+    // timers left armed would retransmit a message nobody waits for, and its late acks are stale
+    for (size_t i = 0; i < message->sent; i++) {
+        auto& state = message->states[i];
+        if (state.acked) {
+            continue;
         }
+        this->timers.cancel(state.rto_timer);
+        this->receive_queue.forget_ack(message->fragments[i].seqnum);
+        this->fragments_in_flight--;
     }
 
-    if (!sent) {
-        Log(LogLevel::ERROR, "[transaction] could not send data package. Cancelling");
-        return false;
+    message->scheduled = false;
+    this->scheduler.remove(message->slot);
+    this->active_messages.erase(std::find(this->active_messages.begin(), this->active_messages.end(), message));
+
+    if (this->active_messages.empty()) {
+        this->apply_latest_ack();
+        this->receive_queue.clear_acks();
+        if (status == OperationStatus::OK) {
+            // updating current seqnum accordingly, from the newest ack of the run
+            this->current_seqnum = this->latest_ack_seqnum;
+        }
     }
 
-    SlowPackage ack_data;
-    bool found = false;
-    int retries = N_RETRIES;
+    std::lock_guard<std::mutex> lock(this->send_mtx);
+    message->status = status;
+    message->done = true;
+    this->send_cv.notify_all();
+}
 
-    while (retries-- > 0) {
-        if (this->check_buffer_for_data(SlowPackage::ACK, seqnum, &ack_data)) {
-            found = true;
-            break;
-        } 
-        std::this_thread::sleep_for(std::chrono::milliseconds(AWAIT_TIME_MS));
+void Transaction::apply_latest_ack() {
+    SlowPackage& ack = this->incoming_package; // drained by drain_receiver_ring, free to reuse here
+    if (this->receive_queue.take_latest_ack(&ack)) {
+        this->cc.set_peer_window(ack.window);
+        this->latest_ack_seqnum = ack.seqnum;
     }
+}
+
+void Transaction::arm_fragment_timer(OutgoingMessage* message, size_t fragment) {
+    uint64_t key = static_cast<uint64_t>(message->slot) << 32 | fragment;
+    message->states[fragment].rto_timer = this->timers.arm_after(this->cc.rto(), [this, key] { this->post_expiry(key); });
+}
+
+void Transaction::retransmit_fragment(OutgoingMessage* message, size_t fragment) {
+    auto& state = message->states[fragment];
+    this->client->send_bytes(message->serialized[fragment]);
+    this->transmit_counters.packages_sent++;
+    this->transmit_counters.retransmissions++;
+    state.sent_at = std::chrono::steady_clock::now();
+    state.retransmitted = true;
+    this->timers.cancel(state.rto_timer);
+    this->arm_fragment_timer(message, fragment);
+}
+
+void Transaction::detect_losses(uint32_t acked_seqnum) {
+    for (auto message : this->active_messages) {
+        for (size_t i = message->first_unacked; i < message->sent; i++) {
+            auto& state = message->states[i];
+            uint32_t seqnum = message->fragments[i].seqnum;
+            if (state.acked || !seqnum_after(acked_seqnum, seqnum) || ++state.later_acks != REORDER_THRESHOLD) {
+                continue;
+            }
+
+            if (!seqnum_after(this->recovery_seqnum, seqnum)) {
+                this->cc.on_loss();
+                this->recovery_seqnum = this->current_seqnum;
+            }
+            Log(LogLevel::WARNING, "[transaction] fragment " + std::to_string(i) + " of fid " + std::to_string(message->fid) + " lost. Retransmitting");
+            this->retransmit_fragment(message, i);
+        }
+    }
+}
+
+void Transaction::send_messages(OutgoingMessage* own) {
+    using clock = std::chrono::steady_clock;
+
+    while (true) {
+        this->adopt_submitted_messages();
+
+        // each message has the deadline and cancellation token of its caller
+        for (size_t m = 0; m < this->active_messages.size();) {
+            auto message = this->active_messages[m];
+            auto budget = check_budget(message->deadline, message->token);
+            if (budget != OperationStatus::OK) {
+                this->finish_message(message, budget);
+                continue;
+            }
+            m++;
+        }
+        if (own->done) {
+            return;
+        }
+
+        auto now = clock::now();
+
+        // sends new fragments while the congestion window and the server window allow it, all of them in one
+        // batch (one syscall), or one at a time when pacing. The scheduler picks the message of each one,
+        // and keeps lower classes to a share of the window
+        uint32_t window = this->cc.send_window();
+        if (this->fragments_in_flight < window && now >= this->next_send_at) {
+            size_t batch = this->cc.pacing_interval().count() > 0 ? 1 : window - this->fragments_in_flight;
+            size_t count = 0;
+            uint32_t slot;
+            while (count < batch && this->scheduler.next(&slot, window, now)) {
+                auto message = this->message_slots[slot].get();
+                size_t i = message->sent++;
+                auto& fragment = message->fragments[i];
+                fragment.seqnum = this->current_seqnum++;
+                fragment.acknum = this->last_acknum;
+                fragment.window = this->receive_window();
+                fragment.serialize(message->serialized[i]);
+                if (message->revive && i == 0) {
+                    this->scheduler.hold(slot, true); // the rest only makes sense if the server accepts the revive
+                }
+
+                // swapped in for the batch and back afterwards, so the bytes stay with their message
+                if (this->batch_bytes.size() <= count) {
+                    this->batch_bytes.emplace_back();
+                    this->batch_fragments.emplace_back(nullptr, 0);
+                }
+                std::swap(this->batch_bytes[count], message->serialized[i]);
+                this->batch_fragments[count] = {message, i};
+                count++;
+            }
+
+            size_t sent = count > 0 ? this->client->send_bytes_batch(this->batch_bytes.data(), count) : 0;
+            // whatever the socket did not take is the tail of the batch: it goes again on the next round
+            for (size_t k = count; k-- > 0;) {
+                auto [message, i] = this->batch_fragments[k];
+                std::swap(this->batch_bytes[k], message->serialized[i]);
+                if (k >= sent) {
+                    message->sent--;
+                    this->current_seqnum--;
+                    this->scheduler.give_back(message->slot);
+                    if (message->revive && i == 0) {
+                        this->scheduler.hold(message->slot, false);
+                    }
+                }
+            }
+
+            if (count > 0 && sent == 0 && this->fragments_in_flight == 0) {
+                // nothing in flight, the socket is not usable
+                while (!this->active_messages.empty()) {
+                    this->finish_message(this->active_messages.front(), OperationStatus::SEND_FAILED);
+                }
+                return;
+            }
+
+            this->receive_queue.expect_more_acks(sent);
+            this->transmit_counters.packages_sent += sent;
+            for (size_t k = 0; k < sent; k++) {
+                auto [message, i] = this->batch_fragments[k];
+                message->states[i].sent_at = now;
+                this->arm_fragment_timer(message, i);
+            }
+            this->fragments_in_flight += sent;
+            if (count > 0) {
+                this->next_send_at = now + this->cc.pacing_interval();
+            }
+        }
+
+        // collects the acks of everything in flight. Loss detection runs once they are all taken: acks are
+        // collected message by message, not in seqnum order, and an ack already there is no loss
+        // what arrives during the scan waits for the next round (its wakeup is newer than the last wait)
+        SlowPackage ack;
+        this->drain_receiver_ring();
+        this->acked_seqnums.clear();
+        for (size_t m = 0; m < this->active_messages.size();) {
+            auto message = this->active_messages[m];
+            bool finished = false;
+            for (size_t i = message->first_unacked; i < message->sent && !finished; i++) {
+                auto& state = message->states[i];
+                if (state.acked || !this->receive_queue.take(SlowPackage::ACK, message->fragments[i].seqnum, &ack)) {
+                    continue;
+                }
+
+                state.acked = true;
+                this->timers.cancel(state.rto_timer);
+                message->acked++;
+                this->fragments_in_flight--;
+                this->scheduler.acked(message->slot);
+                this->consecutive_timeouts = 0;
+
+                auto rtt = std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - state.sent_at);
+                this->cc.on_ack(rtt, !state.retransmitted);
+                if (!state.retransmitted) {
+                    this->client->reportResponse(rtt);
+                }
+                message->last_ack = ack; // the ack of this fragment (its accept flag is checked below)
+                this->acked_seqnums.push_back(message->fragments[i].seqnum);
+
+                // Verifies if the revive request was accepted and sets connection status accordingly
+                if (message->revive && i == 0) {
+                    if (!ack.flag_accept_reject) {
+                        Log(LogLevel::ERROR, "[transaction] server refused connection revive");
+                        this->finish_message(message, OperationStatus::REJECTED);
+                        finished = true;
+                        continue;
+                    }
+                    message->revive_accepted = true;
+                    this->connection_status_mtx.lock();
+                    this->connection_status = ConnectionStatus::CONNECTED;
+                    this->connection_status_mtx.unlock();
+                    this->scheduler.hold(message->slot, false);
+                }
+
+                if (message->acked == message->count) {
+                    this->finish_message(message, OperationStatus::OK);
+                    finished = true;
+                }
+            }
+            if (finished) {
+                continue; // no longer in active_messages
+            }
+
+            while (message->first_unacked < message->sent && message->states[message->first_unacked].acked) {
+                message->first_unacked++;
+            }
+            m++;
+        }
+        this->apply_latest_ack();
+        for (uint32_t seqnum : this->acked_seqnums) {
+            this->detect_losses(seqnum);
+        }
+        if (own->done) {
+            return;
+        }
+
+        // retransmits everything whose timer expired. Expiries of fragments sent before the last timeout
+        // belong to that loss event (the timer thread may post them over several wakeups)
+        {
+            std::lock_guard<std::mutex> lock(this->wake_mtx);
+            std::swap(this->expired_fragments, this->posted_expiries); // both keep their capacity
+        }
+        for (uint64_t key : this->expired_fragments) {
+            auto message = this->message_slots[key >> 32].get();
+            size_t i = key & UINT32_MAX;
+            // only a fired timer of the current transmission counts: the post may be older than an ack or a
+            // retransmission, and a finished message may already be back with its caller (or its slot reused)
+            if (!message->scheduled || i >= message->sent || message->states[i].acked
+                    || this->timers.armed(message->states[i].rto_timer)) {
+                continue;
+            }
+
+            if (message->states[i].sent_at > this->last_timeout_at) {
+                this->last_timeout_at = clock::now();
+                this->cc.on_timeout();
+                this->client->reportTimeout();
+                this->consecutive_timeouts++;
+            }
+
+            // without a deadline, the number of timeouts in a row is the budget
+            if (message->deadline == NO_DEADLINE && this->consecutive_timeouts > MAX_CONSECUTIVE_TIMEOUTS) {
+                Log(LogLevel::ERROR, "[transaction] retransmission timeout limit reached for fragment " + std::to_string(i) + " of fid " + std::to_string(message->fid));
+                this->finish_message(message, OperationStatus::TIMEOUT);
+                continue;
+            }
+
+            Log(LogLevel::WARNING, "[transaction] no ack for fragment " + std::to_string(i) + " of fid " + std::to_string(message->fid) + ". Retransmitting");
+            this->retransmit_fragment(message, i);
+        }
+        this->expired_fragments.clear();
+        if (own->done) {
+            return;
+        }
 
-    if (!found) {
-        if (attempts_left <= 0) {
-            Log(LogLevel::ERROR, "[transaction] attempts exhausted. No ack received from server. Giving up");
-            return false;
+        // acks free window space: the next round sends right away
+        if (!this->acked_seqnums.empty()) {
+            continue;
         }
 
-        // attempts to resend the data up to attempts_left times
-        Log(LogLevel::ERROR, "did not receive ack from server. Retrying..  Attempts left: " + std::to_string(attempts_left));
-        return this->send_data(data, revive, --attempts_left);
+        // sleeps until an ack, a timer or a new message wakes it up, the next paced send or the first deadline
+        auto until = this->next_send_at > now ? this->next_send_at : clock::time_point::max();
+        for (auto message : this->active_messages) {
+            until = std::min(until, message->deadline);
+        }
+        this->wait_for_events(until);
     }
+}
 
-    Log(LogLevel::INFO, "[transaction] ack received for data. Data successfully sent");
+OperationStatus Transaction::exchange(SlowPackage& request, SlowPackage::PackageType response_type, uint32_t acknum,
+        SlowPackage* response, Deadline deadline, const CancellationToken* token, std::chrono::steady_clock::time_point already_sent_at) {
+    using clock = std::chrono::steady_clock;
+
+    auto& request_bytes = this->exchange_bytes;
+    request.serialize(request_bytes);
+    bool can_fail_over = request.type == SlowPackage::CONNECT && this->client->getEndpoints()->size() > 1;
+    // first wait follows the endpoint RTT once it is known
+    auto initial_timeout = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::milliseconds(can_fail_over ? FAILOVER_TIMEOUT_MS : N_RETRIES * AWAIT_TIME_MS));
+    auto timeout = this->client->responseTimeout(initial_timeout);
+
+    // only this response is kept by the receive side, until the exchange is over
+    this->receive_queue.expect_response(response_type, acknum);
+    struct ResponseGuard {
+        ReceiveQueue& queue;
+        ~ResponseGuard() { queue.clear_response(); }
+    } guard {this->receive_queue};
+
+    for (int attempt = 0; deadline != NO_DEADLINE || attempt < MAX_EXCHANGE_ATTEMPTS; attempt++) {
+        auto budget = check_budget(deadline, token);
+        if (budget != OperationStatus::OK) {
+            return budget;
+        }
 
-    // Verifies if the revive request was accepted and sets connection status accordingly
-    if (revive) {
-        if (!ack_data.flag_accept_reject) {
-            Log(LogLevel::ERROR, "[transaction] server refused connection revive");
-            this->connection_status_mtx.lock();
-            this->connection_status = ConnectionStatus::OFFLINE; // setting status to connecting
-            this->connection_status_mtx.unlock();
-            return false;
+        auto sent_at = already_sent_at;
+        if (attempt > 0 || already_sent_at == clock::time_point()) {
+            sent_at = clock::now();
+            if (!this->client->send_bytes(request_bytes)) {
+                Log(LogLevel::ERROR, "[transaction] error sending package");
+                return OperationStatus::SEND_FAILED;
+            }
+            this->transmit_counters.packages_sent++;
+            if (attempt > 0) {
+                this->transmit_counters.retransmissions++;
+            }
         }
-        this->connection_status_mtx.lock();
-        this->connection_status = ConnectionStatus::CONNECTED; // setting status to connecting
-        this->connection_status_mtx.unlock();
+
+        // waits for the response until this attempt's timeout, the deadline or a cancellation.
+        // The listener wakes the wait up on every package
+        auto retransmit_at = clock::now() + timeout;
+        while (clock::now() < retransmit_at) {
+            if (this->check_buffer_for_data(response_type, acknum, response)) {
+                if (attempt == 0) {
+                    // only an unambiguous sample: after a retransmission we cannot tell which copy was answered
+                    this->client->reportResponse(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - sent_at));
+                }
+                return OperationStatus::OK;
+            }
+
+            budget = check_budget(deadline, token);
+            if (budget != OperationStatus::OK) {
+                return budget;
+            }
+            this->wait_for_events(std::min(retransmit_at, deadline));
+        }
+
+        this->client->reportTimeout();
+
+        // a new session does not have to wait for a server that does not answer
+        if (can_fail_over && this->client->failover()) {
+            Log(LogLevel::WARNING, "[transaction] no response from server. Connecting to " + this->client->currentEndpoint().toString());
+            timeout = this->client->responseTimeout(initial_timeout);
+            continue;
+        }
+
+        Log(LogLevel::WARNING, "[transaction] no response from server. Retransmitting");
+        timeout *= 2; // exponential backoff
     }
 
-    // If the revive is accepted
+    return OperationStatus::TIMEOUT;
+}
 
-    // updating curernt seqnum accordingly
-    this->current_seqnum = ack_data.seqnum;
-    
+void Transaction::set_max_payload(size_t bytes) {
+    this->session_max_payload = std::max<size_t>(bytes, 1);
+    if (this->client->getMaxDatagramSize() < this->session_max_payload + HEADER_SIZE) {
+        this->client->setMaxDatagramSize(this->session_max_payload + HEADER_SIZE);
+    }
+    // the client may have capped it at the UDP limit
+    this->session_max_payload = std::min(this->session_max_payload, this->client->getMaxDatagramSize() - HEADER_SIZE);
+}
+
+size_t Transaction::max_payload() const {
+    return this->session_max_payload;
+}
+
+size_t Transaction::max_message_size() const {
+    return this->session_max_payload * MAX_FRAGMENTS;
+}
+
+bool Transaction::discover_max_payload() {
+    // the probes carry a data package without a session (zero sid), which the server drops
+    auto probe = fragmentedDataPackages({}, 0, 0, 0, 0, 0, {});
+    size_t datagram = this->client->discoverMaxDatagramSize(probe[0].serialize());
+    if (datagram <= HEADER_SIZE) {
+        Log(LogLevel::WARNING, "[transaction] path MTU discovery failed. Keeping max payload of " + std::to_string(this->session_max_payload) + " bytes");
+        return false;
+    }
+
+    this->client->setMaxDatagramSize(datagram);
+    this->set_max_payload(datagram - HEADER_SIZE);
+    Log(LogLevel::INFO, "[transaction] max payload set to " + std::to_string(this->session_max_payload) + " bytes");
     return true;
 }
 
-bool Transaction::disconnect() {
+void Transaction::enable_stream_mode(size_t flush_threshold, std::chrono::milliseconds flush_deadline) {
+    this->stream_mode = true;
+    this->stream_flush_threshold = flush_threshold;
+    this->stream_flush_deadline = flush_deadline;
+}
+
+OperationStatus Transaction::disable_stream_mode(Deadline deadline, const CancellationToken* token) {
+    auto status = this->flush(deadline, token);
+    this->stream_mode = false;
+    return status;
+}
+
+OperationStatus Transaction::write(const std::string& data, Deadline deadline, const CancellationToken* token) {
+    if (!this->stream_mode) {
+        return this->send_data(data, false, deadline, token);
+    }
+
+    if (this->stream_buffer.empty()) {
+        this->stream_buffered_since = std::chrono::steady_clock::now();
+    }
+    this->stream_buffer += data;
+
+    size_t threshold = this->stream_flush_threshold > 0 ? this->stream_flush_threshold : this->session_max_payload;
+    if (this->stream_buffer.size() >= threshold) {
+        // only whole packages leave now, the tail keeps waiting for more writes
+        size_t whole_packages = this->stream_buffer.size() / this->session_max_payload * this->session_max_payload;
+        if (whole_packages == 0) {
+            whole_packages = this->stream_buffer.size(); // threshold smaller than one package
+        }
+        auto status = this->send_stream_bytes(whole_packages, deadline, token);
+        if (status != OperationStatus::OK) {
+            return status;
+        }
+    }
+
+    return this->flush_if_due(deadline, token);
+}
+
+OperationStatus Transaction::flush(Deadline deadline, const CancellationToken* token) {
+    if (this->stream_buffer.empty()) {
+        return OperationStatus::OK;
+    }
+    return this->send_stream_bytes(this->stream_buffer.size(), deadline, token);
+}
+
+OperationStatus Transaction::flush_if_due(Deadline deadline, const CancellationToken* token) {
+    if (std::chrono::steady_clock::now() < this->stream_flush_due_at()) {
+        return OperationStatus::OK;
+    }
+    return this->flush(deadline, token);
+}
+
+Deadline Transaction::stream_flush_due_at() const {
+    if (this->stream_buffer.empty()) {
+        return NO_DEADLINE;
+    }
+    return this->stream_buffered_since + this->stream_flush_deadline;
+}
+
+OperationStatus Transaction::send_stream_bytes(size_t count, Deadline deadline, const CancellationToken* token) {
+    // one message per max_message_size bytes. On failure the bytes not sent stay buffered,
+    // so the caller can flush again later
+    while (count > 0) {
+        size_t size = std::min(count, this->max_message_size());
+        auto status = this->send_message(reinterpret_cast<const std::byte*>(this->stream_buffer.data()), size, MessageOptions(), false, deadline, token);
+        if (status != OperationStatus::OK) {
+            return status;
+        }
+
+        // the bytes left keep the time of the oldest one: it may be as old as those just sent
+        this->stream_buffer.erase(0, size);
+        count -= size;
+    }
+    return OperationStatus::OK;
+}
+
+OperationStatus Transaction::disconnect(Deadline deadline, const CancellationToken* token) {
     Log(LogLevel::INFO, "[transaction] requesting disconnect");
 
+    auto flushed = this->flush(deadline, token);
+    if (flushed != OperationStatus::OK) {
+        Log(LogLevel::ERROR, "[transaction] could not flush pending stream data before disconnecting: " + operationStatusToString(flushed));
+        return flushed;
+    }
+
     int seqnum = this->current_seqnum;
 
     auto disconnect_package = disconnectPackage(
@@ -234,61 +793,89 @@ bool Transaction::disconnect() {
         this->last_acknum
     );
 
-    auto package_bytes = disconnect_package.serialize();
-    this->client->send_bytes(package_bytes);
-
     SlowPackage response;
-    bool found = false;
-    int retries = N_RETRIES;
+    auto status = this->exchange(disconnect_package, SlowPackage::ACK, 0, &response, deadline, token);
 
-    while (retries-- > 0) {
-        // if it finds, exit while
-        if(this->check_buffer_for_data(SlowPackage::ACK, 0, &response)) {
-            found = true;
-            break;
-        }
+    // no matter if its successful or not, disconnect
+    this->stop_listener();
 
-        // if it doesnt find, sleep for 100 ms and try again for N_RETRIES
-        std::this_thread::sleep_for(std::chrono::milliseconds(AWAIT_TIME_MS));
-    }
-    
-    if (!found) {
-        Log(LogLevel::ERROR, "[transaction] did not receive any ack from server");
-        return false;
+    if (status != OperationStatus::OK) {
+        Log(LogLevel::ERROR, "[transaction] did not receive any ack from server: " + operationStatusToString(status));
+        return status;
     }
 
     Log(LogLevel::INFO, "[transaction] ack received. Successfully disconnected");
+    return OperationStatus::OK;
+}
 
+void Transaction::start_listener() {
+    if (this->listener_thread.joinable()) {
+        if (this->listener_running) {
+            return; // still listening for this session
+        }
+        this->listener_thread.join(); // previous listener already finished
+    }
+    this->listener_running = true;
+    this->listener_thread = std::thread(&Transaction::listen_to_incoming_data, this);
+}
+
+void Transaction::stop_listener() {
     this->connection_status_mtx.lock();
-    this->connection_status = ConnectionStatus::OFFLINE; // no matter if its successful or not, disconnect
+    this->connection_status = ConnectionStatus::OFFLINE;
     this->connection_status_mtx.unlock();
 
-    return true;
+    if (this->listener_thread.joinable()) {
+        if (this->listener_wake_fd >= 0) {
+            uint64_t one = 1;
+            (void)!::write(this->listener_wake_fd, &one, sizeof(one)); // out of its wait, it sees the status
+        }
+        this->listener_thread.join();
+    }
 }
 
 bool Transaction::check_buffer_for_data(SlowPackage::PackageType type, uint32_t acknum, SlowPackage* package) {
+    this->drain_receiver_ring();
+    return this->receive_queue.take(type, acknum, package);
+}
 
-    this->buffer_mtx.lock();
-    
-    // checks if theres an ack with the matching acknum = seqnum
-    int index = 0;
-    for (auto pack : this->receiver_buffer) {
-        // if its type and matches acknum, then it found
-        if (pack.acknum == acknum && pack.type == type) {
-            *package = pack;
-
-            // removing this package from buffer (consuming it)
-            this->receiver_buffer.erase(this->receiver_buffer.begin() + index);
-
-            this->buffer_mtx.unlock();
-            return true;
+void Transaction::drain_receiver_ring() {
+    // filters everything the listener has published so far: only what an operation waits for is kept
+    auto& incoming = this->incoming_package;
+    while (this->receiver_ring.try_pop(incoming)) {
+        if (this->receive_queue.offer(incoming) && seqnum_after(incoming.acknum, this->last_acknum)) {
+            this->last_acknum = incoming.acknum; // never goes back on reordered packages
         }
-        index++;
     }
+}
+
+uint64_t Transaction::dropped_packages() const {
+    return this->receiver_ring.dropped();
+}
 
-    this->buffer_mtx.unlock();
+TransmitStats Transaction::transmit_stats() const {
+    return this->transmit_counters;
+}
 
-    return false;
+ReceiveStats Transaction::receive_stats() const {
+    ReceiveStats stats = this->receive_queue.stats();
+    stats.overflow = this->receiver_ring.dropped();
+    return stats;
+}
+
+void Transaction::enable_pacing(bool enabled) {
+    this->cc.set_pacing(enabled);
+}
+
+const CongestionControl& Transaction::congestion_control() const {
+    return this->cc;
+}
+
+uint16_t Transaction::receive_window() const {
+    size_t used = this->receiver_ring.size() + this->receive_queue.pending();
+    if (used >= RECEIVER_RING_SIZE) {
+        return 0;
+    }
+    return static_cast<uint16_t>(RECEIVER_RING_SIZE - used);
 }
 
 void Transaction::listen_to_incoming_data() {
@@ -302,26 +889,39 @@ void Transaction::listen_to_incoming_data() {
             break;
         } // exists once the connection is over
 
-        // raw bytes
-        auto data = this->client->receive_bytes();
-
-        if (data.empty()) {
-            continue; // no data received, continue listening
+        // raw bytes, into a buffer kept for the whole session
+        auto& data = this->listener_bytes;
+        if (this->client->receive_bytes(data) < 0) {
+            // nothing received: sleeps in the kernel until a datagram arrives or stop_listener wakes it up
+            if (!this->client->waitForData(std::chrono::milliseconds(LISTENER_WAIT_MS), this->listener_wake_fd)
+                    && this->listener_wake_fd >= 0) {
+                uint64_t wakeups;
+                (void)!::read(this->listener_wake_fd, &wakeups, sizeof(wakeups));
+            }
+            continue;
         }
 
         Log(LogLevel::INFO, "[transaction] received a package from server");
-        
 
-        // deserializing into SlowPackage
-        auto package = SlowPackage::deserialize(data);
-        this->last_acknum = package->acknum; // updating last acknum
+        // deserializing into the package kept by the listener (its payload buffer is reused)
+        auto& package = this->listener_package;
+        if (!SlowPackage::deserialize(data.data(), data.size(), package)) {
+            continue; // malformed package
+        }
 
-        Log(LogLevel::INFO, "[transaction] package: " + package->toString());
+        if (LogEnabled(LogLevel::INFO)) {
+            Log(LogLevel::INFO, "[transaction] package: " + package.toString());
+        }
 
-        this->buffer_mtx.lock();
-        this->receiver_buffer.emplace_back(*package);
-        this->buffer_mtx.unlock();
+        // never blocks: if the consumer is not keeping up, the package is dropped and counted.
+        // Copied in and out (see SpscRing::try_pop), so each ring slot reuses its own payload buffer
+        if (!this->receiver_ring.push_or_drop(package)) {
+            Log(LogLevel::WARNING, "[transaction] receiver ring full, package dropped. Total dropped: " + std::to_string(this->receiver_ring.dropped()));
+            continue;
+        }
+        this->wake_consumer();
     }
 
+    this->listener_running = false;
     Log(LogLevel::INFO, "[transaction] [LISTENER THREAD] listener thread finished");
 }
\ No newline at end of file
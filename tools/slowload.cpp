@@ -0,0 +1,425 @@
+// slowload: sustained multi-session load generator for SLOW servers.
+//
+// Runs N sessions (each its own UdpClient + Transaction + thread) sending messages of a given size at a
+// target rate per session for a duration, optionally disconnecting and reviving every K messages.
+// Reports throughput, latency percentiles (log-linear histogram, ~1.5% resolution), retransmit rate and
+// CPU usage. Latency is measured from the time a message was scheduled, not from when it was actually
+// sent, so a server that falls behind shows up in the percentiles instead of silently lowering the rate.
+//
+// --local starts a stand-in server in a child process (stateless: accepts every session, acks every
+// package, optional loss), so runs do not depend on a remote server.
+//
+// usage: ./bin/slowload [options] [host:port ...]
+//   --local [port]       stand-in server on 127.0.0.1 (default port 7033), used when no server is given
+//   --sessions N         concurrent sessions (default 4)
+//   --rate R             messages per second per session, 0 = as fast as possible (default 100)
+//   --size B             message size in bytes (default 1000)
+//   --duration S         seconds (default 10)
+//   --revive-every K     disconnect after every K messages, the next one revives the session (default 0: never)
+//   --timeout MS         deadline of each operation (default 2000)
+//   --loss P             stand-in server: fraction of packages dropped (default 0)
+//   --backend B          socket or io_uring (default socket)
+//   --verbose            INFO logs
+//
+// Exits with a non-zero status if any operation failed.
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <arpa/inet.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "endpoint_set.hpp"
+#include "logger.hpp"
+#include "slow_package.hpp"
+#include "transaction.hpp"
+#include "udp_client.hpp"
+
+#define DEFAULT_LOCAL_PORT 7033
+#define LOCAL_WINDOW 256 // packages the stand-in server advertises
+#define LOCAL_STTL_MS 60000
+#define SERVER_SOCKET_BUFFER (4 * 1024 * 1024)
+
+using load_clock = std::chrono::steady_clock;
+
+struct Config {
+    std::vector<Endpoint> endpoints;
+    bool local = false;
+    int local_port = DEFAULT_LOCAL_PORT;
+    size_t sessions = 4;
+    double rate = 100;
+    size_t size = 1000;
+    double duration = 10;
+    uint64_t revive_every = 0;
+    std::chrono::milliseconds timeout {2000};
+    double loss = 0;
+    UdpBackend backend = UdpBackend::SOCKET;
+    bool verbose = false;
+};
+
+// Log-linear latency histogram (HDR style): values below 128 us are exact, above that each power of
+// two is split in 64 buckets, so any percentile is within ~1.5% of the real value. Fixed size, so
+// recording never allocates
+class LatencyHistogram {
+    public:
+        void record(uint64_t micros) {
+            counts[index_of(micros)]++;
+            total++;
+            max_value = std::max(max_value, micros);
+        }
+
+        void merge(const LatencyHistogram& other) {
+            for (size_t i = 0; i < BUCKETS; i++) {
+                counts[i] += other.counts[i];
+            }
+            total += other.total;
+            max_value = std::max(max_value, other.max_value);
+        }
+
+        // smallest value with at least fraction of the samples at or below it (upper edge of its bucket)
+        uint64_t percentile(double fraction) const {
+            if (total == 0) {
+                return 0;
+            }
+            uint64_t rank = static_cast<uint64_t>(std::ceil(fraction * total));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < BUCKETS; i++) {
+                seen += counts[i];
+                if (seen >= std::max<uint64_t>(rank, 1)) {
+                    return std::min(upper_edge(i), max_value);
+                }
+            }
+            return max_value;
+        }
+
+        uint64_t count() const { return total; }
+        uint64_t max() const { return max_value; }
+
+    private:
+        static constexpr uint64_t LINEAR = 128; // exact up to here
+        static constexpr int SUB_BITS = 6;      // 64 buckets per power of two above it
+        static constexpr size_t BUCKETS = LINEAR + (64 - 7) * (1 << SUB_BITS);
+
+        std::array<uint64_t, BUCKETS> counts {};
+        uint64_t total = 0;
+        uint64_t max_value = 0;
+
+        static size_t index_of(uint64_t value) {
+            if (value < LINEAR) {
+                return value;
+            }
+            int shift = (63 - __builtin_clzll(value)) - SUB_BITS; // value >> shift is in [64, 128)
+            return LINEAR + (shift - 1) * (1 << SUB_BITS) + ((value >> shift) - (1 << SUB_BITS));
+        }
+
+        static uint64_t upper_edge(size_t index) {
+            if (index < LINEAR) {
+                return index;
+            }
+            int shift = (index - LINEAR) / (1 << SUB_BITS) + 1;
+            uint64_t sub = (index - LINEAR) % (1 << SUB_BITS) + (1 << SUB_BITS);
+            return ((sub + 1) << shift) - 1;
+        }
+};
+
+struct SessionResult {
+    LatencyHistogram latency;
+    uint64_t ok = 0;
+    uint64_t failed = 0;
+    uint64_t revives = 0;
+    uint64_t connect_failures = 0;
+    TransmitStats transmit;
+    ReceiveStats receive;
+};
+
+static double process_cpu_seconds(int who) {
+    rusage usage;
+    getrusage(who, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// stand-in server: CONNECT -> accepting SETUP with a new session id, DATA (and revives) -> ACK of its
+// seqnum, DISCONNECT -> ACK. Stateless, answers with the session id of each request
+static void run_local_server(int fd, double loss) {
+    std::mt19937_64 rng(std::random_device{}());
+    std::uniform_real_distribution<double> drop(0, 1);
+    std::array<std::byte, 65536> buffer;
+    std::vector<std::byte> out;
+    SlowPackage request;
+    SlowPackage response;
+    response.sttl = LOCAL_STTL_MS;
+    response.window = LOCAL_WINDOW;
+    uint32_t seqnum = 1;
+
+    while (true) {
+        sockaddr_in from {};
+        socklen_t len = sizeof(from);
+        ssize_t received = recvfrom(fd, buffer.data(), buffer.size(), 0, reinterpret_cast<sockaddr*>(&from), &len);
+        if (received < 0 || !SlowPackage::deserialize(buffer.data(), received, request)) {
+            continue;
+        }
+        if (loss > 0 && drop(rng) < loss) {
+            continue;
+        }
+
+        // deserialize guesses the type from the client side, the flags tell what was sent
+        bool connect = request.flag_connect && !request.flag_revive;
+        bool disconnect = request.flag_connect && request.flag_revive;
+
+        response.sid = request.sid;
+        if (connect) {
+            for (auto& byte : response.sid) {
+                byte = static_cast<std::byte>(rng());
+            }
+        }
+        response.seqnum = seqnum++;
+        response.acknum = connect || disconnect ? 0 : request.seqnum;
+        response.flag_accept_reject = true;
+        response.flag_ack = !connect; // SETUP has no ack flag
+
+        response.serialize(out);
+        sendto(fd, out.data(), out.size(), 0, reinterpret_cast<sockaddr*>(&from), len);
+    }
+}
+
+static pid_t start_local_server(const Config& config) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int size = SERVER_SOCKET_BUFFER;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    sockaddr_in addr {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config.local_port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        perror("bind (stand-in server)");
+        std::exit(EXIT_FAILURE);
+    }
+
+    // bound before forking, so the first CONNECT cannot get there before the server
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        std::exit(EXIT_FAILURE);
+    }
+    if (pid == 0) {
+        run_local_server(fd, config.loss);
+        _exit(EXIT_SUCCESS);
+    }
+    close(fd);
+    return pid;
+}
+
+static void run_session(size_t index, const Config& config, std::shared_ptr<EndpointSet> endpoints,
+        load_clock::time_point start, load_clock::time_point end, SessionResult* result) {
+    UdpClient client(endpoints, config.backend);
+    client.setupConnection();
+    Transaction transaction(&client);
+
+    if (transaction.connect(deadlineIn(config.timeout)) != OperationStatus::OK) {
+        result->connect_failures++;
+    }
+
+    std::string message(config.size, 'x');
+    // sessions start spread over one interval, so they do not all send at the same instant
+    auto interval = config.rate > 0
+        ? std::chrono::duration_cast<load_clock::duration>(std::chrono::duration<double>(1.0 / config.rate))
+        : load_clock::duration::zero();
+    load_clock::time_point next = start + interval * static_cast<long>(index) / static_cast<long>(config.sessions);
+    bool revive = false;
+
+    for (uint64_t sent = 0; ; sent++) {
+        if (config.rate > 0) {
+            std::this_thread::sleep_until(next);
+        }
+        auto scheduled = config.rate > 0 ? next : load_clock::now();
+        if (scheduled >= end) {
+            break;
+        }
+        next += interval;
+
+        if (!revive && transaction.connection_status != ConnectionStatus::CONNECTED) {
+            if (transaction.connect(deadlineIn(config.timeout)) != OperationStatus::OK) {
+                result->connect_failures++;
+                result->failed++;
+                continue;
+            }
+        }
+
+        auto status = transaction.send_data(message, revive, deadlineIn(config.timeout));
+        auto finished = load_clock::now();
+        if (status != OperationStatus::OK) {
+            result->failed++;
+            revive = false; // reconnects on the next message
+            continue;
+        }
+
+        result->ok++;
+        result->revives += revive ? 1 : 0;
+        result->latency.record(std::chrono::duration_cast<std::chrono::microseconds>(finished - scheduled).count());
+        revive = false;
+
+        if (config.revive_every > 0 && (sent + 1) % config.revive_every == 0
+                && transaction.disconnect(deadlineIn(config.timeout)) == OperationStatus::OK) {
+            revive = true;
+        }
+    }
+
+    if (transaction.connection_status == ConnectionStatus::CONNECTED) {
+        transaction.disconnect(deadlineIn(config.timeout));
+    }
+    result->transmit = transaction.transmit_stats();
+    result->receive = transaction.receive_stats();
+}
+
+static void usage() {
+    std::fprintf(stderr, "usage: slowload [--local [port]] [--sessions N] [--rate R] [--size B] [--duration S]\n"
+        "                [--revive-every K] [--timeout MS] [--loss P] [--backend socket|io_uring] [--verbose] [host:port ...]\n");
+    std::exit(EXIT_FAILURE);
+}
+
+static Config parse_arguments(int argc, char** argv) {
+    Config config;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() -> const char* {
+            if (i + 1 >= argc) {
+                usage();
+            }
+            return argv[++i];
+        };
+
+        if (arg == "--local") {
+            config.local = true;
+            if (i + 1 < argc && argv[i + 1][0] != '-' && std::strchr(argv[i + 1], ':') == nullptr) {
+                config.local_port = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--sessions") {
+            config.sessions = std::max<long>(1, std::atol(value()));
+        } else if (arg == "--rate") {
+            config.rate = std::max(0.0, std::atof(value()));
+        } else if (arg == "--size") {
+            config.size = std::atol(value());
+        } else if (arg == "--duration") {
+            config.duration = std::atof(value());
+        } else if (arg == "--revive-every") {
+            config.revive_every = std::atol(value());
+        } else if (arg == "--timeout") {
+            config.timeout = std::chrono::milliseconds(std::atol(value()));
+        } else if (arg == "--loss") {
+            config.loss = std::atof(value());
+        } else if (arg == "--backend") {
+            std::string backend = value();
+            if (backend != "socket" && backend != "io_uring") {
+                usage();
+            }
+            config.backend = backend == "io_uring" ? UdpBackend::IO_URING : UdpBackend::SOCKET;
+        } else if (arg == "--verbose") {
+            config.verbose = true;
+        } else {
+            Endpoint endpoint;
+            if (!parseEndpoint(arg, &endpoint)) {
+                usage();
+            }
+            config.endpoints.push_back(endpoint);
+        }
+    }
+
+    if (config.endpoints.empty()) {
+        config.local = true;
+    }
+    if (config.local) {
+        config.endpoints.insert(config.endpoints.begin(), Endpoint{"127.0.0.1", config.local_port});
+    }
+    return config;
+}
+
+int main(int argc, char** argv) {
+    Config config = parse_arguments(argc, argv);
+    setLogLevel(config.verbose ? LogLevel::INFO : LogLevel::ERROR);
+
+    // forked before any thread exists
+    pid_t server = config.local ? start_local_server(config) : -1;
+
+    std::string servers;
+    for (const auto& endpoint : config.endpoints) {
+        servers += (servers.empty() ? "" : ", ") + endpoint.toString();
+    }
+    std::printf("slowload: %zu sessions, %zu B messages, %s, %.0f s, server %s%s\n", config.sessions, config.size,
+        config.rate > 0 ? (std::to_string(static_cast<long>(config.rate)) + " msg/s per session").c_str() : "closed loop",
+        config.duration, servers.c_str(), config.local ? (" (stand-in, loss " + std::to_string(config.loss * 100).substr(0, 4) + "%)").c_str() : "");
+
+    auto endpoints = std::make_shared<EndpointSet>(config.endpoints);
+    std::vector<SessionResult> results(config.sessions);
+    std::vector<std::thread> threads;
+
+    double cpu_start = process_cpu_seconds(RUSAGE_SELF);
+    auto start = load_clock::now();
+    auto end = start + std::chrono::duration_cast<load_clock::duration>(std::chrono::duration<double>(config.duration));
+    for (size_t i = 0; i < config.sessions; i++) {
+        threads.emplace_back(run_session, i, std::cref(config), endpoints, start, end, &results[i]);
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(load_clock::now() - start).count();
+    double cpu_seconds = process_cpu_seconds(RUSAGE_SELF) - cpu_start;
+
+    double server_cpu_seconds = 0;
+    if (server > 0) {
+        kill(server, SIGTERM);
+        waitpid(server, nullptr, 0);
+        server_cpu_seconds = process_cpu_seconds(RUSAGE_CHILDREN);
+    }
+
+    SessionResult total;
+    for (const auto& result : results) {
+        total.latency.merge(result.latency);
+        total.ok += result.ok;
+        total.failed += result.failed;
+        total.revives += result.revives;
+        total.connect_failures += result.connect_failures;
+        total.transmit.packages_sent += result.transmit.packages_sent;
+        total.transmit.retransmissions += result.transmit.retransmissions;
+        total.receive.duplicates += result.receive.duplicates;
+        total.receive.stale += result.receive.stale;
+        total.receive.overflow += result.receive.overflow;
+    }
+
+    auto ms = [](uint64_t micros) { return micros / 1000.0; };
+    std::printf("messages     %llu ok, %llu failed (%llu revives, %llu connect failures)\n",
+        static_cast<unsigned long long>(total.ok), static_cast<unsigned long long>(total.failed),
+        static_cast<unsigned long long>(total.revives), static_cast<unsigned long long>(total.connect_failures));
+    std::printf("throughput   %.1f msg/s, %.3f MB/s\n", total.ok / seconds, total.ok * config.size / seconds / 1e6);
+    std::printf("latency      p50 %.3f ms, p99 %.3f ms, p999 %.3f ms, max %.3f ms\n",
+        ms(total.latency.percentile(0.50)), ms(total.latency.percentile(0.99)),
+        ms(total.latency.percentile(0.999)), ms(total.latency.max()));
+    std::printf("retransmits  %llu of %llu packages (%.2f%%)\n",
+        static_cast<unsigned long long>(total.transmit.retransmissions), static_cast<unsigned long long>(total.transmit.packages_sent),
+        total.transmit.packages_sent > 0 ? 100.0 * total.transmit.retransmissions / total.transmit.packages_sent : 0.0);
+    std::printf("receive      %llu duplicates, %llu stale, %llu ring overflows\n",
+        static_cast<unsigned long long>(total.receive.duplicates), static_cast<unsigned long long>(total.receive.stale),
+        static_cast<unsigned long long>(total.receive.overflow));
+    std::printf("cpu          client %.1f%% of one core (%.1f us per message)", 100 * cpu_seconds / seconds,
+        total.ok > 0 ? cpu_seconds * 1e6 / total.ok : 0.0);
+    if (server > 0) {
+        std::printf(", stand-in server %.1f%%", 100 * server_cpu_seconds / seconds);
+    }
+    std::printf("\n");
+
+    return total.failed == 0 && total.connect_failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}